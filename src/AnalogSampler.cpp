@@ -0,0 +1,223 @@
+#include "AnalogSampler.h"
+#include "IRFMotorDriver.h"
+#include "Profiler.h"
+#include <avr/interrupt.h>
+
+AnalogSampler* _analogSamplerInstance = nullptr;
+
+static_assert(ANALOG_BEMF_MAX_GAP_US / 4 <= 65535, "ANALOG_BEMF_MAX_GAP_US too long for the 16-bit dt");
+
+ISR(ADC_vect) {
+    PROFILE_SCOPE(PROF_ADC_ISR);
+    if (_analogSamplerInstance) {
+        _analogSamplerInstance->_isr();
+    }
+}
+
+AnalogSampler::AnalogSampler() :
+    _channelCount(0), _sampleCount(0), _channel(0), _burstLeft(0), _busy(false),
+    _bemfEnabled(false), _bemfStep(0), _bemfPending(false), _bemfFirst(0), _bemfRail(255), _bemfTime(0),
+    _bemfRestart(false), _bemf(0), _bemfUpdates(0), _bemfIntegral(0), _seq(0)
+{
+    _bemfMux[0] = 0;
+    _bemfMux[1] = 0;
+    for (uint8_t i = 0; i < ANALOG_MAX_CHANNELS; i++) {
+        _mux[i] = 0;
+        _sum[i] = 0;
+        _value[i] = 0;
+        _updates[i] = 0;
+    }
+}
+
+uint8_t AnalogSampler::addChannel(uint8_t pin) {
+    if (_channelCount >= ANALOG_MAX_CHANNELS) return ANALOG_MAX_CHANNELS - 1;
+    _mux[_channelCount] = (pin >= A0 ? pin - A0 : pin) & 0x07;
+    return _channelCount++;
+}
+
+void AnalogSampler::setBackEmfPins(uint8_t pin1, uint8_t pin2) {
+    _bemfMux[0] = (pin1 >= A0 ? pin1 - A0 : pin1) & 0x07;
+    _bemfMux[1] = (pin2 >= A0 ? pin2 - A0 : pin2) & 0x07;
+    _bemfEnabled = true;
+}
+
+void AnalogSampler::setBackEmfRail(uint8_t channel) {
+    _bemfRail = channel < ANALOG_MAX_CHANNELS ? channel : 255;
+}
+
+void AnalogSampler::begin() {
+    if (_channelCount == 0 && !_bemfEnabled) return;
+    _analogSamplerInstance = this;
+
+    noInterrupts();
+    // Digital input buffers off on the scanned pins (A6/A7 have none)
+    for (uint8_t i = 0; i < _channelCount; i++) {
+        if (_mux[i] < 6) DIDR0 |= (1 << _mux[i]);
+    }
+    for (uint8_t i = 0; _bemfEnabled && i < 2; i++) {
+        if (_bemfMux[i] < 6) DIDR0 |= (1 << _bemfMux[i]);
+    }
+    _channel = 0;
+    ADMUX = (1 << REFS0) | _mux[0]; // AVcc reference
+    // Enable, interrupt on completion, prescaler 128 -> 125kHz ADC clock, ~104us per conversion
+    ADCSRA = (1 << ADEN) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    // Auto trigger on the Timer1 capture event. With ICR1 as TOP (mode 14) ICF1 is set at TOP,
+    // the end of every PWM period, and nothing else uses it: the driver's overflow interrupt
+    // keeps TOV1 to itself. A trigger that arrives mid-conversion is ignored, so the ADC converts
+    // every few PWM periods, always at the same phase.
+    ADCSRB = (1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0);
+    TIFR1 = (1 << ICF1);
+    ADCSRA |= (1 << ADATE);
+#endif
+    interrupts();
+}
+
+uint16_t AnalogSampler::read(uint8_t channel) const {
+    uint8_t seq;
+    uint16_t v;
+    do {
+        seq = _seq;
+        v = _value[channel];
+    } while ((seq & 1) || seq != _seq);
+    return v;
+}
+
+int16_t AnalogSampler::readBackEmf() const {
+    uint8_t seq;
+    int16_t v;
+    do {
+        seq = _seq;
+        v = _bemf;
+    } while ((seq & 1) || seq != _seq);
+    return v;
+}
+
+int32_t AnalogSampler::readBackEmfIntegral() const {
+    uint8_t seq;
+    int32_t v;
+    do {
+        seq = _seq;
+        v = _bemfIntegral;
+    } while ((seq & 1) || seq != _seq);
+    return v;
+}
+
+void AnalogSampler::pwmTrigger(uint8_t phase) {
+    if (_analogSamplerInstance) {
+        _analogSamplerInstance->_trigger(phase);
+    }
+}
+
+// Called from the software PWM ISR at the period start or a back-EMF window
+void AnalogSampler::_trigger(uint8_t phase) {
+#if IRF_PWM_BACKEND != IRF_PWM_TIMER1
+    if (phase == IRF_PHASE_BRAKE) _bemfRestart = true; // Otherwise a period start like any other
+    if (phase == IRF_PHASE_COAST) {
+        if (!_bemfEnabled || _bemfStep != 0) return;
+        if (_busy) {
+            _bemfPending = true; // Taken over at the end of the running conversion
+            return;
+        }
+        _busy = true;
+        startBackEmf();
+        return;
+    }
+    if (_busy || _channelCount == 0) return; // Previous burst still running, keep its phase
+    _busy = true;
+    _burstLeft = ANALOG_BURST_ROUNDS * _channelCount;
+    startConversion();
+#endif
+}
+
+void AnalogSampler::startConversion() {
+    ADCSRA |= (1 << ADSC);
+}
+
+void AnalogSampler::startBackEmf() {
+    _bemfPending = false;
+    _bemfStep = 1;
+    ADMUX = (1 << REFS0) | _bemfMux[0];
+    startConversion();
+}
+
+// One conversion of the back-EMF burst. The blanking result is dropped, the difference is
+// published after terminal 2 and the scan resumes with the next trigger. A sample with a terminal
+// at the rail is dropped (setBackEmfRail()). The integral uses the trapezoid between two samples
+// (~16ms apart), bridging dropped ones. Across an e-break or a gap over ANALOG_BEMF_MAX_GAP_US it
+// adds nothing: the stale sample would count the whole stop as turning.
+void AnalogSampler::backEmfSample() {
+    uint16_t v = ADC;
+    if (_bemfStep == 2) {
+        _bemfFirst = v;
+    } else if (_bemfStep == 3) {
+        uint16_t high = (_bemfFirst > v ? _bemfFirst : v) << 2;
+        if (_bemfRail == 255 || high < _value[_bemfRail]) {
+            int16_t bemf = ((int16_t)_bemfFirst - (int16_t)v) << 2;
+            if (bemf > 0) bemf += ANALOG_BEMF_CLAMP;
+            else if (bemf < 0) bemf -= ANALOG_BEMF_CLAMP;
+            uint32_t now = micros();
+            uint32_t gap = now - _bemfTime;
+            _bemfTime = now;
+            _seq++;
+            if (gap <= ANALOG_BEMF_MAX_GAP_US && !_bemfRestart) {
+                uint16_t dt = gap >> 2; // micros() counts in 4us steps
+                _bemfIntegral += ((int32_t)(_bemf + bemf) * dt) >> 7;
+            }
+            _bemfRestart = false;
+            _bemf = bemf;
+            _bemfUpdates++;
+            _seq++;
+        }
+        _bemfStep = 0;
+        ADMUX = (1 << REFS0) | _mux[_channel];
+        _busy = false;
+        return;
+    }
+    _bemfStep++;
+    ADMUX = (1 << REFS0) | _bemfMux[_bemfStep - 2];
+    startConversion();
+}
+
+void AnalogSampler::_isr() {
+    if (_bemfStep != 0) {
+        backEmfSample();
+        return;
+    }
+    
+    _sum[_channel] += ADC;
+
+    if (++_channel >= _channelCount) {
+        _channel = 0;
+        if (++_sampleCount >= (1 << ANALOG_OVERSAMPLE_SHIFT)) {
+            // Decimate to the 12-bit scale and publish
+            _seq++;
+            for (uint8_t i = 0; i < _channelCount; i++) {
+#if ANALOG_OVERSAMPLE_SHIFT >= 2
+                _value[i] = _sum[i] >> (ANALOG_OVERSAMPLE_SHIFT - 2);
+#else
+                _value[i] = _sum[i] << (2 - ANALOG_OVERSAMPLE_SHIFT);
+#endif
+                _updates[i]++;
+                _sum[i] = 0;
+            }
+            _seq++;
+            _sampleCount = 0;
+        }
+    }
+    // The new channel takes effect with the next conversion start
+    ADMUX = (1 << REFS0) | _mux[_channel];
+
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    TIFR1 = (1 << ICF1); // Re-arm the trigger, only a new flag starts a conversion
+#else
+    if (_bemfPending) {
+        _burstLeft = 0; // The back-EMF window is short, drop the rest of the scan burst
+        startBackEmf();
+    } else if (--_burstLeft > 0) {
+        startConversion();
+    } else {
+        _busy = false;
+    }
+#endif
+}
@@ -0,0 +1,127 @@
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include <Arduino.h>
+
+// Number of channels the sampler can scan
+#ifndef ANALOG_MAX_CHANNELS
+#define ANALOG_MAX_CHANNELS 4
+#endif
+
+// Samples summed per published value, as a power of two (2 = 4 samples, 4 = 16 samples).
+// Every value is published on a 12-bit scale (0..ANALOG_FULL_SCALE) regardless, the extra
+// samples past 4 only reduce noise.
+#ifndef ANALOG_OVERSAMPLE_SHIFT
+#define ANALOG_OVERSAMPLE_SHIFT 2
+#endif
+
+// Rounds over all channels converted per PWM trigger. Each round adds one sample per channel at
+// the same offset from the period start every time.
+#ifndef ANALOG_BURST_ROUNDS
+#define ANALOG_BURST_ROUNDS 2
+#endif
+
+#define ANALOG_FULL_SCALE 4092  // 1023 << 2
+
+// While the bridge floats, the lower motor terminal is pulled below ground by its divider until the
+// low-side body diode clamps it, and reads 0. The back-EMF reads this much low, in 12-bit codes on
+// the 40V divider (~0.5V), and is corrected by it. See tools/turn_sim.py.
+#ifndef ANALOG_BEMF_CLAMP
+#define ANALOG_BEMF_CLAMP 51
+#endif
+
+// The back-EMF integral bridges dropped samples up to this gap (four IRF_BEMF_INTERVAL_US windows).
+// After a longer gap, or an e-break, the held sample no longer describes the motor and the
+// integral restarts from the next sample instead.
+#ifndef ANALOG_BEMF_MAX_GAP_US
+#define ANALOG_BEMF_MAX_GAP_US 64000
+#endif
+
+/**
+ * Free-running ADC scanner on the ADC complete interrupt.
+ *
+ * Conversions start at a fixed phase of the motor PWM: a software PWM period start calls
+ * pwmTrigger() from the driver ISR, the Timer1 backend auto-triggers on Timer1 reaching TOP.
+ * Each trigger converts ANALOG_BURST_ROUNDS rounds over all channels back to back, so every
+ * sample of a channel sees the same switching noise. The samples are summed and decimated into
+ * a snapshot that read() returns in constant time without blocking the ISR.
+ *
+ * Optionally the two motor terminals (through the same kind of divider as the battery input) are
+ * converted at every back-EMF window of the driver: one blanking conversion while the winding
+ * current decays, then terminal 1 and terminal 2. That burst pre-empts a running scan burst.
+ * The ISR also integrates the back-EMF over time, which is proportional to the rotor angle.
+ *
+ * Owns the ADC: do not call analogRead() once begin() ran.
+ */
+class AnalogSampler {
+public:
+    AnalogSampler();
+
+    // Register an analog pin (A0..A7) before begin(). Returns the channel index for read().
+    uint8_t addChannel(uint8_t pin);
+
+    // Configure the ADC and start scanning on the next PWM trigger
+    void begin();
+
+    // Latest decimated value of a channel, 0..ANALOG_FULL_SCALE
+    uint16_t read(uint8_t channel) const;
+
+    // Number of values published for a channel so far (wraps), useful to spot a stalled trigger
+    uint8_t getUpdateCount(uint8_t channel) const { return _updates[channel]; }
+
+    // Motor terminal pins sampled in the back-EMF windows, before begin()
+    void setBackEmfPins(uint8_t pin1, uint8_t pin2);
+    // Channel reading the pack through the same kind of divider. A terminal at or above it is still
+    // returning the winding current to the pack through a body diode (a high current outlasts the
+    // blanking conversion), that sample is not a back-EMF and is dropped.
+    void setBackEmfRail(uint8_t channel);
+    // Latest terminal 1 - terminal 2 voltage on the 12-bit scale (single sample, signed)
+    int16_t readBackEmf() const;
+    // Number of back-EMF samples published so far (wraps)
+    uint8_t getBackEmfCount() const { return _bemfUpdates; }
+    // Running back-EMF integral in codes x 256us, held between samples and over an e-break or a
+    // gap longer than ANALOG_BEMF_MAX_GAP_US. Wraps, use differences.
+    int32_t readBackEmfIntegral() const;
+
+    // PWM-synchronised start of a burst, registered with IRFMotorDriver::setPeriodHook()
+    static void pwmTrigger(uint8_t phase);
+
+    // Internal methods called by ISRs
+    void _trigger(uint8_t phase);
+    void _isr();
+
+private:
+    uint8_t _mux[ANALOG_MAX_CHANNELS];       // ADMUX channel bits
+    uint8_t _channelCount;
+
+    // ISR-owned accumulation state
+    uint16_t _sum[ANALOG_MAX_CHANNELS];
+    uint8_t _sampleCount;                    // Samples per channel in the running sum
+    uint8_t _channel;                        // Channel being converted
+    uint8_t _burstLeft;                      // Conversions left in this burst
+    volatile bool _busy;
+    
+    // Back-EMF burst: step 1 = blanking, 2 = terminal 1, 3 = terminal 2, 0 = not running
+    uint8_t _bemfMux[2];
+    bool _bemfEnabled;
+    uint8_t _bemfStep;
+    volatile bool _bemfPending;              // Window opened during a scan burst
+    uint16_t _bemfFirst;
+    uint8_t _bemfRail;                       // Channel of the pack voltage, 255 = none
+    uint32_t _bemfTime;                      // micros() of the last back-EMF sample
+    volatile bool _bemfRestart;              // E-break seen, do not integrate up to the next sample
+
+    // Published snapshot, seqlock protected: odd _seq means an update is in progress
+    volatile uint16_t _value[ANALOG_MAX_CHANNELS];
+    volatile uint8_t _updates[ANALOG_MAX_CHANNELS];
+    volatile int16_t _bemf;
+    volatile uint8_t _bemfUpdates;
+    volatile int32_t _bemfIntegral;
+    volatile uint8_t _seq;
+
+    void startConversion();
+    void startBackEmf();
+    void backEmfSample();
+};
+
+#endif // ANALOG_SAMPLER_H
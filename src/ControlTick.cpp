@@ -0,0 +1,90 @@
+#include "ControlTick.h"
+#include <avr/interrupt.h>
+
+ControlTick* _controlTickInstance = nullptr;
+
+ISR(TIMER0_COMPA_vect) {
+    if (_controlTickInstance) {
+        _controlTickInstance->_isr();
+    }
+}
+
+ControlTick::ControlTick() :
+    _fn(nullptr), _running(false), _count(0), _overruns(0), _maxUs(0)
+{
+}
+
+void ControlTick::begin(void (*fn)()) {
+    _fn = fn;
+    _controlTickInstance = this;
+
+    // Timer0 keeps the core's mode and prescaler, only the compare A interrupt is added. An
+    // analogWrite() on D6 moves OCR0A but the interrupt still fires once per period.
+    noInterrupts();
+    OCR0A = CONTROL_TICK_PHASE;
+    TIFR0 = (1 << OCF0A);
+    TIMSK0 |= (1 << OCIE0A);
+    interrupts();
+}
+
+// TIMSK0 is only written from the main context, the ISR uses _running instead
+void ControlTick::lock() {
+    noInterrupts();
+    TIMSK0 &= ~(1 << OCIE0A);
+    interrupts();
+}
+
+void ControlTick::unlock() {
+    noInterrupts();
+    TIMSK0 |= (1 << OCIE0A);
+    interrupts();
+}
+
+uint32_t ControlTick::getCount() const {
+    noInterrupts();
+    uint32_t c = _count;
+    interrupts();
+    return c;
+}
+
+// The ISR writes these, read both bytes in one go
+uint16_t ControlTick::getOverruns() const {
+    noInterrupts();
+    uint16_t n = _overruns;
+    interrupts();
+    return n;
+}
+
+uint16_t ControlTick::getMaxUs() const {
+    noInterrupts();
+    uint16_t us = _maxUs;
+    interrupts();
+    return us;
+}
+
+void ControlTick::resetStats() {
+    noInterrupts();
+    _overruns = 0;
+    _maxUs = 0;
+    interrupts();
+}
+
+// Entered with interrupts disabled. The tick function runs with them enabled; the guard keeps
+// the next compare from nesting into a long tick.
+void ControlTick::_isr() {
+    if (_running) {
+        _overruns++;
+        return;
+    }
+    _running = true;
+    _count++;
+    interrupts();
+
+    uint32_t start = micros();
+    if (_fn) _fn();
+    uint32_t us = micros() - start;
+
+    noInterrupts();
+    if (us > _maxUs) _maxUs = us > 65535 ? 65535 : us;
+    _running = false;
+}
@@ -0,0 +1,51 @@
+#ifndef CONTROL_TICK_H
+#define CONTROL_TICK_H
+
+#include <Arduino.h>
+
+// Timer0 compare A point within each Timer0 period. Any value works, mid-period keeps the tick
+// clear of the millis() overflow interrupt.
+#define CONTROL_TICK_PHASE 128
+
+/**
+ * ~1 kHz control tick for the mode state machines.
+ *
+ * Timer0 is the Arduino core's millis()/PWM timer (fast PWM, /64, 976.6 Hz). Its compare A
+ * interrupt fires once per period at CONTROL_TICK_PHASE without touching the core's setup, so
+ * the tick is hardware paced whatever loop() is doing. The tick function runs with interrupts
+ * re-enabled, so the motor PWM, ADC and TWI interrupts are never held off by it; a tick still
+ * running at the next compare skips that tick and counts an overrun.
+ *
+ * Main-context code that touches state the tick function uses (the active mode, its inputs)
+ * wraps that in lock()/unlock(). A tick that came due while locked runs right after unlock().
+ */
+class ControlTick {
+public:
+    ControlTick();
+
+    // Start calling fn from the Timer0 compare interrupt
+    void begin(void (*fn)());
+
+    // Hold the tick off from the main context. Not nested, keep the section short.
+    void lock();
+    void unlock();
+
+    uint32_t getCount() const;
+    uint16_t getOverruns() const;
+    uint16_t getMaxUs() const;   // Longest tick function run
+    void resetStats();
+
+    // Internal method called by ISR
+    void _isr();
+
+private:
+    void (*_fn)();
+    volatile bool _running;
+    volatile uint32_t _count;
+    volatile uint16_t _overruns;
+    volatile uint16_t _maxUs;
+};
+
+extern ControlTick* _controlTickInstance;
+
+#endif // CONTROL_TICK_H
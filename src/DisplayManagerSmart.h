@@ -2,11 +2,101 @@
 #define DISPLAY_MANAGER_H
 
 #include <U8g2lib.h>
+#include <util/crc16.h>
+#include "TwiQueue.h"
 
+// U8g2 byte callback on the interrupt-driven TwiQueue: every message only queues bytes
+static uint8_t u8x8_byte_twi_queue(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+    switch (msg) {
+        case U8X8_MSG_BYTE_SEND: {
+            uint8_t* data = (uint8_t*)arg_ptr;
+            while (arg_int--) _twiQueueInstance->write(*data++);
+            break;
+        }
+        case U8X8_MSG_BYTE_START_TRANSFER:
+            _twiQueueInstance->beginTransmission(u8x8_GetI2CAddress(u8x8));
+            break;
+        case U8X8_MSG_BYTE_END_TRANSFER:
+            _twiQueueInstance->endTransmission();
+            break;
+        case U8X8_MSG_BYTE_INIT:   // TwiQueue::begin() runs before the display
+        case U8X8_MSG_BYTE_SET_DC: // Part of the I2C control byte
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+// SSD1306 128x64, one page buffer, on the TwiQueue instead of Wire (build with U8X8_NO_HW_I2C)
+class U8G2_SSD1306_128X64_NONAME_1_TWI_QUEUE : public U8G2 {
+public:
+    U8G2_SSD1306_128X64_NONAME_1_TWI_QUEUE(const u8g2_cb_t* rotation) : U8G2() {
+        u8g2_Setup_ssd1306_i2c_128x64_noname_1(getU8g2(), rotation, u8x8_byte_twi_queue, u8x8_gpio_and_delay_arduino);
+    }
+};
+
+// Diff granularity: one CRC16 per DISPLAY_DIFF_TILES horizontal 8x8 tiles. 2 tiles = 16x8 px,
+// 64 CRCs (128 bytes of RAM) for the 128x64 panel instead of a 1KB copy of the frame.
+#define DISPLAY_TILE_COLS  16
+#define DISPLAY_TILE_ROWS  8
+#define DISPLAY_DIFF_TILES 2
+#define DISPLAY_DIFF_GROUPS (DISPLAY_TILE_COLS / DISPLAY_DIFF_TILES)
+
+// Queue room needed to send a page without waiting: 128 data bytes plus the page address
+// commands and the per-transfer headers
+#define DISPLAY_PAGE_BYTES 176
+static_assert(DISPLAY_PAGE_BYTES < TWI_QUEUE_SIZE, "TWI_QUEUE_SIZE must hold a display page");
+
+// Screens the incremental renderer can draw
+#define SCREEN_NONE  0
+#define SCREEN_INFO  1
+#define SCREEN_TITLE 2
+
+// What is on (or going to) the screen, reduced to pixels so that changes too small to see do not
+// trigger a redraw
+struct ScreenContent {
+    uint8_t screen;
+    const char* name;
+    uint8_t modeIndex;
+    bool motorOn;
+    int8_t motorFill;      // Signed bar width in px, CW to the right
+    int8_t progressFill;   // px, -1 = no sequence
+    uint8_t batteryFill;   // px
+    uint8_t heatFill;      // px
+
+    bool operator==(const ScreenContent& o) const {
+        return screen == o.screen && name == o.name && modeIndex == o.modeIndex &&
+               motorOn == o.motorOn && motorFill == o.motorFill && progressFill == o.progressFill &&
+               batteryFill == o.batteryFill && heatFill == o.heatFill;
+    }
+    bool operator!=(const ScreenContent& o) const { return !(*this == o); }
+};
+
+/**
+ * U8g2 page mode renderer that never blocks for a whole frame.
+ *
+ * updateModeInfo() and showModeTitle() only record what to show. loop() renders and queues one
+ * 8-pixel page per call (8 calls per frame), so the time spent per main loop is bounded by a single
+ * page. The TwiQueue sends it in the background, and loop() skips its turn until the previous
+ * page has left enough room. A frame only starts when the content differs from what is on the
+ * screen, and restarts from the top if the content changes while it is being sent.
+ *
+ * Only tiles that changed are sent: every rendered page is compared against a CRC shadow of what
+ * the panel holds, and runs of changed tiles go out with u8x8_DrawTile(). A bar moving by a few
+ * pixels costs a couple of tiles instead of the whole screen.
+ */
 class DisplayManager {
 private:
-    U8G2_SSD1306_128X64_NONAME_1_HW_I2C display;
-    unsigned long lastUpdate;
+    TwiQueue twi;
+    U8G2_SSD1306_128X64_NONAME_1_TWI_QUEUE display;
+    ScreenContent shown;     // Last complete frame
+    ScreenContent wanted;    // Latest request
+    ScreenContent drawing;   // Frame being sent
+    bool frameActive;
+    uint16_t shadow[DISPLAY_TILE_ROWS][DISPLAY_DIFF_GROUPS];  // CRC of each tile group on the panel
+    bool shadowValid;
+    uint16_t twiErrors;      // TwiQueue error count the shadow was last checked against
     
     // Get text width for current font (6x10)
     int getTextWidth(const char* text) {
@@ -25,133 +115,225 @@ private:
     
 public:
     DisplayManager() : 
-        display(U8G2_R0, U8X8_PIN_NONE),
-        lastUpdate(0) 
-    {}
+        display(U8G2_R0),
+        frameActive(false), shadowValid(false), twiErrors(0)
+    {
+        memset(&shown, 0, sizeof(shown));
+        memset(&wanted, 0, sizeof(wanted));
+        memset(&drawing, 0, sizeof(drawing));
+    }
     
     bool begin() {
+        twi.begin();
         display.begin();
         display.setFont(u8g2_font_6x10_tf);
         return true;
     }
     
     void showModeTitle(const char* modeName) {
-        display.firstPage();
-        do {
-            // Use 7x14 font for mode switch screen
-            display.setFont(u8g2_font_7x14_tf);
-            
-            // Center horizontally and vertically
-            int xPos = centerTextXLarge(modeName);
-            display.setCursor(xPos, 25);
-            display.print(modeName);
-            
-            // Underline
-            int textWidth = strlen(modeName) * 7;
-            display.drawHLine(xPos, 40, textWidth);
-            
-            // Reset font
-            display.setFont(u8g2_font_6x10_tf);
-            
-        } while (display.nextPage());
+        memset(&wanted, 0, sizeof(wanted));
+        wanted.screen = SCREEN_TITLE;
+        wanted.name = modeName;
+    }
+    
+    void updateModeInfo(const char* modeName, uint8_t modeIndex, float motorSpeed, float sequenceProgress, int batterytLevel = 50, int thermalLoad = 0) {
+        ScreenContent c;
+        c.screen = SCREEN_INFO;
+        c.name = modeName;
+        c.modeIndex = modeIndex;
+        c.motorOn = fabs(motorSpeed) > 0.01f;
+        if (motorSpeed > 1.0f) motorSpeed = 1.0f;
+        if (motorSpeed < -1.0f) motorSpeed = -1.0f;
+        c.motorFill = motorSpeed * (116 / 2);
+        c.progressFill = sequenceProgress < 0 ? -1 : (sequenceProgress > 1.0f ? 116 : sequenceProgress * 116);
+        c.batteryFill = 18 - (batterytLevel / 100.0f) * 18;
+        c.heatFill = thermalLoad > 100 ? 8 : thermalLoad * 8 / 100;
+        wanted = c;
     }
     
-    void updateModeInfo(const char* modeName, uint8_t modeIndex, float motorSpeed, float sequenceProgress, int batterytLevel = 50) {
-        unsigned long now = millis();
-        if (now - lastUpdate < 40) return;
-        lastUpdate = now;
+    // Render and send at most one page. Call every loop().
+    void loop() {
+        if (twi.space() < DISPLAY_PAGE_BYTES) return;
         
-        display.firstPage();
-        do {
-            // SECTION 1: TITLE BAR (Top 20px)
-            // White background
-            display.drawBox(0, 0, 128, 20);
-            display.setDrawColor(0); // Black text on white
-                        
-            // Proper text positioning for 6x10 font
-            int nameY = 13; // Baseline for 6x10 font in 20px bar
-            int nameWidth = getTextWidth(modeName);
-            int nameX = (128 - nameWidth) / 2;
-            
-            display.setCursor(nameX, nameY);
-            display.print(modeName);
-            
-            // Mode number at right
-            char modeNum[4];
-            sprintf(modeNum, "%d", modeIndex + 1);
-            int numWidth = getTextWidth(modeNum);
-            display.setCursor(128 - numWidth - 5, nameY);
-            display.print(modeNum);
-            
-            // Battery level indicator on the left (for future use, currently just a placeholder)
-            display.drawFrame(5, 5, 20, 10);
-            int fillWidth = 18 - (batterytLevel / 100.0f) * 18;  
-            display.drawBox(6 + (18 - fillWidth), 6, fillWidth, 8);
-            
-
-            // Reset drawing color
-            display.setDrawColor(1);
-            
-            // SECTION 2: MOTOR SPEED BAR (Middle 22px)
-            // Draw only when motor is running (|speed| > 0.01)
-            if (fabs(motorSpeed) > 0.01f) {
-                int motorBarY = 25;
-                int motorBarHeight = 12;
-                int motorBarWidth = 116;
-                if (sequenceProgress < 0) {
-                    motorBarY = 35;
-                    motorBarHeight = 24;
-                }
-                
-                // Always draw center line and bar outline
-                display.drawVLine(64, motorBarY - 1, motorBarHeight + 2);
-                display.drawFrame(6, motorBarY, motorBarWidth, motorBarHeight);
-            
-                if (motorSpeed > 0.01f) {
-                    // CW (right side)
-                    int fillWidth = motorSpeed * (motorBarWidth/2);
-                    if (fillWidth > 0) {
-                        display.drawBox(64, motorBarY, fillWidth, motorBarHeight);
-                    }
-                } 
-                else if (motorSpeed < -0.01f) {
-                    // CCW (left side)
-                    int fillWidth = -motorSpeed * (motorBarWidth/2);
-                    if (fillWidth > 0) {
-                        display.drawBox(64 - fillWidth, motorBarY, fillWidth, motorBarHeight);
-                    }
+        // The shadow is updated when a tile is queued. A transaction the TwiQueue dropped (NACK,
+        // bus reset) never reached the panel, so forget the shadow and send a whole frame again.
+        uint16_t errors = twi.getErrorCount();
+        if (errors != twiErrors) {
+            twiErrors = errors;
+            shadowValid = false;
+            if (frameActive) startFrame();
+            else shown.screen = SCREEN_NONE;
+        }
+        
+        if (!frameActive) {
+            if (wanted == shown || wanted.screen == SCREEN_NONE) return;
+            drawing = wanted;
+            frameActive = true;
+            startFrame();
+        } else if (wanted != drawing) {
+            // Content changed mid-frame: start over so the frame is never a mix of both
+            drawing = wanted;
+            startFrame();
+        }
+        
+        if (drawing.screen == SCREEN_TITLE) {
+            drawTitle(drawing);
+        } else {
+            drawInfo(drawing);
+        }
+        if (!finishPage()) {
+            frameActive = false;
+            shown = drawing;
+        }
+    }
+    
+private:
+    // firstPage() without the page loop: clear the buffer and point it at the top row
+    void startFrame() {
+        display.clearBuffer();
+        display.setBufferCurrTileRow(0);
+    }
+    
+    // nextPage() replacement: send the changed tile groups of the rendered page, then move the
+    // buffer to the next row. Returns false after the last page.
+    bool finishPage() {
+        uint8_t row = display.getU8g2()->tile_curr_row;
+        uint8_t* buf = display.getBufferPtr();
+        uint8_t runStart = 0;
+        uint8_t runLength = 0;
+        
+        for (uint8_t g = 0; g <= DISPLAY_DIFF_GROUPS; g++) {
+            bool dirty = false;
+            if (g < DISPLAY_DIFF_GROUPS) {
+                uint16_t crc = 0xFFFF;
+                uint8_t* p = buf + g * DISPLAY_DIFF_TILES * 8;
+                for (uint8_t i = 0; i < DISPLAY_DIFF_TILES * 8; i++) {
+                    crc = _crc_ccitt_update(crc, p[i]);
                 }
-            }            
-            // SECTION 3: SEQUENCE PROGRESS (Bottom 22px)
-            int progressY = 50;
-            int progressHeight = 12;
-            int progressWidth = 116;
+                dirty = !shadowValid || crc != shadow[row][g];
+                shadow[row][g] = crc;
+            }
+            if (dirty) {
+                if (runLength == 0) runStart = g;
+                runLength++;
+            } else if (runLength > 0) {
+                u8x8_DrawTile(display.getU8x8(), runStart * DISPLAY_DIFF_TILES, row,
+                              runLength * DISPLAY_DIFF_TILES, buf + runStart * DISPLAY_DIFF_TILES * 8);
+                runLength = 0;
+            }
+        }
+        
+        row += display.getBufferTileHeight();
+        if (row >= DISPLAY_TILE_ROWS) {
+            shadowValid = true;
+            return false;
+        }
+        display.clearBuffer();
+        display.setBufferCurrTileRow(row);
+        return true;
+    }
+    
+
+    void drawTitle(const ScreenContent& c) {
+        // Use 7x14 font for mode switch screen
+        display.setFont(u8g2_font_7x14_tf);
+        
+        // Center horizontally and vertically
+        int xPos = centerTextXLarge(c.name);
+        display.setCursor(xPos, 25);
+        display.print(c.name);
+        
+        // Underline
+        int textWidth = strlen(c.name) * 7;
+        display.drawHLine(xPos, 40, textWidth);
+        
+        // Reset font
+        display.setFont(u8g2_font_6x10_tf);
+    }
+    
+    void drawInfo(const ScreenContent& c) {
+        // SECTION 1: TITLE BAR (Top 20px)
+        // White background
+        display.drawBox(0, 0, 128, 20);
+        display.setDrawColor(0); // Black text on white
+                    
+        // Proper text positioning for 6x10 font
+        int nameY = 13; // Baseline for 6x10 font in 20px bar
+        int nameWidth = getTextWidth(c.name);
+        int nameX = (128 - nameWidth) / 2;
+        
+        display.setCursor(nameX, nameY);
+        display.print(c.name);
+        
+        // Mode number at right
+        char modeNum[4];
+        sprintf(modeNum, "%d", c.modeIndex + 1);
+        int numWidth = getTextWidth(modeNum);
+        display.setCursor(128 - numWidth - 5, nameY);
+        display.print(modeNum);
+        
+        // Battery level indicator on the left
+        display.drawFrame(5, 5, 20, 10);
+        display.drawBox(6 + (18 - c.batteryFill), 6, c.batteryFill, 8);
+        
+        // Thermal gauge left of the mode number, full at the allowed temperature rise
+        display.drawFrame(104, 5, 5, 10);
+        display.drawBox(105, 6 + (8 - c.heatFill), 3, c.heatFill);
+        
+        // Reset drawing color
+        display.setDrawColor(1);
+        
+        // SECTION 2: MOTOR SPEED BAR (Middle 22px)
+        // Draw only when motor is running (|speed| > 0.01)
+        if (c.motorOn) {
+            int motorBarY = 25;
+            int motorBarHeight = 12;
+            int motorBarWidth = 116;
+            if (c.progressFill < 0) {
+                motorBarY = 35;
+                motorBarHeight = 24;
+            }
             
-            if (sequenceProgress >= 0) {
-                // Sequence active - show progress bar
-                display.drawFrame(6, progressY, progressWidth, progressHeight);
-                
-                // Fill progress
-                if (sequenceProgress > 0) {
-                    int fill = sequenceProgress * progressWidth;
-                    if (fill > 0) {
-                        display.drawBox(6, progressY, fill, progressHeight);
-                    }
-                }
-                
-                // End markers
-                display.drawVLine(6, progressY - 2, progressHeight + 4);
-                display.drawVLine(122, progressY - 2, progressHeight + 4);
+            // Always draw center line and bar outline
+            display.drawVLine(64, motorBarY - 1, motorBarHeight + 2);
+            display.drawFrame(6, motorBarY, motorBarWidth, motorBarHeight);
+        
+            if (c.motorFill > 0) {
+                // CW (right side)
+                display.drawBox(64, motorBarY, c.motorFill, motorBarHeight);
+            } 
+            else if (c.motorFill < 0) {
+                // CCW (left side)
+                display.drawBox(64 + c.motorFill, motorBarY, -c.motorFill, motorBarHeight);
             }
-            if (fabs(motorSpeed) <= 0.01f && sequenceProgress < 0) {                
-                // No sequence active - show "READY"
-                int textX = centerTextX("READY");
-                display.setCursor(textX, progressY);
-                display.print("READY");
+        }            
+        // SECTION 3: SEQUENCE PROGRESS (Bottom 22px)
+        int progressY = 50;
+        int progressHeight = 12;
+        int progressWidth = 116;
+        
+        if (c.progressFill >= 0) {
+            // Sequence active - show progress bar
+            display.drawFrame(6, progressY, progressWidth, progressHeight);
+            
+            // Fill progress
+            if (c.progressFill > 0) {
+                display.drawBox(6, progressY, c.progressFill, progressHeight);
             }
-        } while (display.nextPage());
+            
+            // End markers
+            display.drawVLine(6, progressY - 2, progressHeight + 4);
+            display.drawVLine(122, progressY - 2, progressHeight + 4);
+        }
+        if (!c.motorOn && c.progressFill < 0) {                
+            // No sequence active - show "READY"
+            int textX = centerTextX("READY");
+            display.setCursor(textX, progressY);
+            display.print("READY");
+        }
     }
     
+public:
     void showSplash() {
         display.firstPage();
         do {
@@ -181,6 +363,7 @@ public:
             display.setFont(u8g2_font_6x10_tf);
             
         } while (display.nextPage());
+        shadowValid = false; // Sent around the diff
         delay(1500);
     }
 };
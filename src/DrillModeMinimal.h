@@ -3,34 +3,62 @@
 
 #include <Arduino.h>
 #include "IRFMotorDriver.h"
+#include "SpeedControl.h"
 
 class DrillMode {
 protected:
     const char* name;
     uint8_t state;
+    uint8_t pwmProfile;
     IRFMotorDriver* motor;
+    SpeedControl* speedControl;  // Back-EMF speed and turns, nullptr = open loop
     
 public:
     static const uint8_t STATE_IDLE = 0;
     static const uint8_t STATE_RUNNING = 1;
     
-    DrillMode(const char* n) : name(n), state(STATE_IDLE), motor(nullptr) {}
+    DrillMode(const char* n) : name(n), state(STATE_IDLE), pwmProfile(IRF_PWM_DEFAULT), motor(nullptr), speedControl(nullptr) {}
     
     virtual void begin() {}
-    virtual void loop(float knob) = 0;
+    // One step of the mode state machine, run for the active mode at every control tick (~1 kHz,
+    // see ControlTick.h) from the timer interrupt with interrupts enabled. Keep it short and do
+    // not print. knob is a Q1.15 fraction, 0..IRF_DUTY_MAX.
+    virtual void tick(int16_t knob) = 0;
     virtual void stop() {}
     
+    // Motor stall, reported from the control tick right after tick(). Returns true if the mode
+    // backed off.
+    virtual bool onStall() {
+        return false;
+    }
+    
     virtual float getSequenceProgress() const {
         return -1.0f; // Default: no sequence
     }
     
+    // PWM off-phase behaviour this mode wants, applied by main.cpp when the mode becomes active
+    virtual uint8_t getDecay() const {
+        return IRF_DECAY_FAST;
+    }
+    
+    // IRF_PWM_* profile requested in begin(), applied by main.cpp when the mode becomes active
+    uint8_t getPwmProfile() const { return pwmProfile; }
+    
     void setMotor(IRFMotorDriver* m) { motor = m; }
+    // Opt in to back-EMF speed regulation (modes that drive through driveSpeed()) or turn counting
+    void setSpeedControl(SpeedControl* s) { speedControl = s; }
     const char* getName() const { return name; }
     uint8_t getState() const { return state; }
     
 protected:
     IRFMotorDriver* getMotor() { return motor; }
     void setState(uint8_t s) { state = s; }
+    void requestPwmProfile(uint8_t p) { pwmProfile = p; }
+    
+    // Drive at a Q1.15 target speed: through the PI loop if enabled, else as a plain duty
+    void driveSpeed(int16_t target) {
+        motor->setDuty(speedControl ? speedControl->regulate(target) : target);
+    }
 };
 
 #endif
\ No newline at end of file
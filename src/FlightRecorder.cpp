@@ -0,0 +1,201 @@
+#include "FlightRecorder.h"
+#include <avr/wdt.h>
+
+#define FLIGHT_MAGIC 0xF1A8  // Changes with the layout below
+
+// The ring and its indices live in .noinit: neither zeroed nor initialised at start-up
+struct FlightLog {
+    uint16_t magic;
+    uint8_t head;       // Next byte to write
+    uint8_t tail;       // First byte of the oldest record, head == tail = empty
+    uint8_t stuckTask;  // setStuckTask()
+    uint8_t data[FLIGHT_RECORDER_SIZE];
+};
+
+static FlightLog flightLog __attribute__((section(".noinit")));
+static uint8_t flightResetCause __attribute__((section(".noinit")));
+
+// Runs before the C runtime initialises anything. Saves and clears the reset flags and stops the
+// watchdog, which stays armed at its shortest timeout after a watchdog reset. Optiboot clears
+// MCUSR itself and hands the value over in r2.
+void flightCaptureReset() __attribute__((naked, used, section(".init3")));
+void flightCaptureReset() {
+    uint8_t cause = MCUSR;
+    if (cause == 0) {
+        asm volatile("mov %0, r2" : "=r"(cause));
+    }
+    flightResetCause = cause;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+static uint8_t flightNext(uint8_t i) {
+    return i + 1 >= FLIGHT_RECORDER_SIZE ? 0 : i + 1;
+}
+
+// Bytes in the record starting at i
+static uint8_t flightRecordLength(uint8_t i) {
+    uint8_t h = flightLog.data[i];
+    uint8_t n = 1;
+    for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) {
+        if (h & (1 << f)) n++;
+    }
+    if ((h >> 5) == 7) n++;
+    return n;
+}
+
+FlightRecorder::FlightRecorder() : _ticks(0), _sinceKey(0), _active(false) {
+    for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) _last[f] = 0;
+}
+
+uint8_t FlightRecorder::getResetCause() {
+    return flightResetCause;
+}
+
+bool FlightRecorder::hasCrashLog() const {
+    if (!(flightResetCause & ((1 << WDRF) | (1 << BORF)))) return false;
+    return flightLog.magic == FLIGHT_MAGIC &&
+           flightLog.head < FLIGHT_RECORDER_SIZE && flightLog.tail < FLIGHT_RECORDER_SIZE &&
+           flightLog.head != flightLog.tail;
+}
+
+void FlightRecorder::dump(Print& out) const {
+    out.print(F("Reset:"));
+    if (flightResetCause & (1 << WDRF)) out.print(F(" watchdog"));
+    if (flightResetCause & (1 << BORF)) out.print(F(" brown-out"));
+    if (flightResetCause & (1 << EXTRF)) out.print(F(" external"));
+    if (flightResetCause & (1 << PORF)) out.print(F(" power-on"));
+    out.println();
+    if (!hasCrashLog()) return;
+
+    // Pass 1: total ticks, so times can be printed relative to the reset. Counting the bytes
+    // left keeps a ring torn by the reset from being walked past its end.
+    uint8_t used = (uint8_t)((flightLog.head + FLIGHT_RECORDER_SIZE - flightLog.tail) % FLIGHT_RECORDER_SIZE);
+    uint32_t total = 0;
+    uint8_t left = used;
+    for (uint8_t i = flightLog.tail; left > 0; ) {
+        uint8_t h = flightLog.data[i];
+        uint8_t n = flightRecordLength(i);
+        if (n > left) break;
+        uint8_t delta = h >> 5;
+        if (delta == 7) delta = flightLog.data[flightNext(i)];
+        total += delta;
+        left -= n;
+        i = (i + n) % FLIGHT_RECORDER_SIZE;
+    }
+
+    // Pass 2: apply the changes, fields stay unknown until a record sets them
+    out.println(F("ticks mode knob% duty% volt bridge task"));
+    uint8_t v[FLIGHT_FIELDS] = { 0 };
+    uint8_t known = 0;
+    uint32_t t = 0;
+    left = used;
+    for (uint8_t i = flightLog.tail; left > 0; ) {
+        uint8_t h = flightLog.data[i];
+        uint8_t n = flightRecordLength(i);
+        if (n > left) break;
+        left -= n;
+        uint8_t j = flightNext(i);
+        uint8_t delta = h >> 5;
+        if (delta == 7) {
+            delta = flightLog.data[j];
+            j = flightNext(j);
+        }
+        for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) {
+            if (h & (1 << f)) {
+                v[f] = flightLog.data[j];
+                j = flightNext(j);
+            }
+        }
+        known |= h & 0x1F;
+        t += delta;
+        i = j;
+        if ((h & 0x1F) == 0) continue; // Keep-alive
+
+        out.print('-');
+        out.print(total - t);
+        for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) {
+            out.print(' ');
+            if (!(known & (1 << f))) {
+                out.print('?');
+                if (f == FLIGHT_STATE) out.print(F(" ?"));
+                continue;
+            }
+            if (f == FLIGHT_KNOB) out.print((uint16_t)v[f] * 100 / 255);
+            else if (f == FLIGHT_DUTY) out.print((int16_t)(int8_t)v[f] * 100 / 128);
+            else if (f == FLIGHT_BATTERY) out.print(v[f] / 10.0f, 1);
+            else if (f == FLIGHT_STATE) {
+                out.print(v[f] & 0x03);
+                if (v[f] & 0x04) out.print('B');
+                out.print(' ');
+                if ((v[f] >> 4) == 15) out.print('-');
+                else out.print(v[f] >> 4);
+            }
+            else out.print(v[f]);
+        }
+        out.println();
+    }
+}
+
+void FlightRecorder::begin() {
+    flightLog.magic = FLIGHT_MAGIC;
+    flightLog.head = 0;
+    flightLog.tail = 0;
+    flightLog.stuckTask = FLIGHT_NOT_STUCK;
+    _ticks = 0;
+    _sinceKey = FLIGHT_KEYFRAME_EVERY; // First record is a full snapshot
+    _active = true;
+}
+
+void FlightRecorder::setStuckTask(uint8_t task) {
+    if (_active) flightLog.stuckTask = task;
+}
+
+uint8_t FlightRecorder::getStuckTask() const {
+    return hasCrashLog() ? flightLog.stuckTask : FLIGHT_NOT_STUCK;
+}
+
+void FlightRecorder::record(const uint8_t* sample) {
+    if (!_active) return;
+    if (_ticks < 255) _ticks++;
+
+    uint8_t mask = 0;
+    for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) {
+        if (sample[f] != _last[f]) mask |= 1 << f;
+    }
+    if (mask == 0 && _ticks < 255) return;
+    if (mask != 0 && _sinceKey >= FLIGHT_KEYFRAME_EVERY) mask = 0x1F;
+
+    uint8_t rec[2 + FLIGHT_FIELDS];
+    uint8_t n = 1;
+    if (_ticks < 7) {
+        rec[0] = mask | (_ticks << 5);
+    } else {
+        rec[0] = mask | (7 << 5);
+        rec[n++] = _ticks;
+    }
+    for (uint8_t f = 0; f < FLIGHT_FIELDS; f++) {
+        if (mask & (1 << f)) {
+            rec[n++] = sample[f];
+            _last[f] = sample[f];
+        }
+    }
+    put(rec, n);
+
+    _ticks = 0;
+    _sinceKey = mask == 0x1F ? 0 : _sinceKey + 1;
+}
+
+// Append a record, dropping the oldest ones to make room
+void FlightRecorder::put(const uint8_t* bytes, uint8_t n) {
+    uint8_t used = (uint8_t)((flightLog.head + FLIGHT_RECORDER_SIZE - flightLog.tail) % FLIGHT_RECORDER_SIZE);
+    while (FLIGHT_RECORDER_SIZE - 1 - used < n) {
+        uint8_t len = flightRecordLength(flightLog.tail);
+        flightLog.tail = (flightLog.tail + len) % FLIGHT_RECORDER_SIZE;
+        used -= len;
+    }
+    for (uint8_t k = 0; k < n; k++) {
+        flightLog.data[flightLog.head] = bytes[k];
+        flightLog.head = flightNext(flightLog.head);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <Arduino.h>
+
+// Ring size in bytes, at most 255. Idle costs 2 bytes per 255 ticks, a running mode a few bytes
+// per change, so this holds from a few hundred ms of busy ramping up to ~25s of idle.
+#ifndef FLIGHT_RECORDER_SIZE
+#define FLIGHT_RECORDER_SIZE 192
+#endif
+
+// A full snapshot at least every this many records, the dump decodes from the first one
+#define FLIGHT_KEYFRAME_EVERY 16
+
+// Sample fields, one byte each
+#define FLIGHT_MODE    0  // Mode index
+#define FLIGHT_KNOB    1  // Knob, Q1.15 >> 7
+#define FLIGHT_DUTY    2  // Commanded duty, Q1.15 >> 8, signed
+#define FLIGHT_BATTERY 3  // Filtered battery voltage in 0.1V
+#define FLIGHT_STATE   4  // Bridge state (bits 0-1), e-break (bit 2), running loop() task (bits 4-7, 15 = none)
+#define FLIGHT_FIELDS  5
+
+// setStuckTask() value while loop() runs normally
+#define FLIGHT_NOT_STUCK 254
+
+/**
+ * Flight recorder that survives resets.
+ *
+ * record() takes a sample every control tick and appends only the fields that changed, with the
+ * ticks since the previous record, to a ring in the .noinit section. The ring is not cleared by
+ * the C runtime, so after a watchdog or brown-out reset the last moments before it are still
+ * there: hasCrashLog() tells from the reset cause (MCUSR, captured before main()) and dump()
+ * prints them.
+ *
+ * Record: header byte = changed field mask (bits 0-4) | tick delta (bits 5-7, 7 = a delta byte
+ * follows), then one byte per changed field. record() and dump() are not meant to run at the
+ * same time; dump before begin().
+ */
+class FlightRecorder {
+public:
+    FlightRecorder();
+
+    // MCUSR at reset: PORF, EXTRF, BORF, WDRF bits
+    static uint8_t getResetCause();
+
+    // Watchdog or brown-out reset with an intact ring from before it
+    bool hasCrashLog() const;
+
+    // Print the reset cause and the decoded ring, oldest first, ticks counted back from the reset
+    void dump(Print& out) const;
+
+    // Clear the ring and start recording
+    void begin();
+
+    // Add one tick's sample, FLIGHT_FIELDS bytes. Called from the control tick.
+    void record(const uint8_t* sample);
+
+    // Task loop() is stuck in (255 = between tasks), or FLIGHT_NOT_STUCK. Set from the control
+    // tick, kept over the reset next to the ring.
+    void setStuckTask(uint8_t task);
+    // What was set before the reset, FLIGHT_NOT_STUCK without a crash log
+    uint8_t getStuckTask() const;
+
+private:
+    uint8_t _last[FLIGHT_FIELDS];
+    uint8_t _ticks;         // Since the last record
+    uint8_t _sinceKey;      // Records since the last full snapshot
+    bool _active;
+
+    void put(const uint8_t* bytes, uint8_t n);
+};
+
+#endif // FLIGHT_RECORDER_H
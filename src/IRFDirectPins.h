@@ -0,0 +1,141 @@
+#ifndef IRF_DIRECT_PINS_H
+#define IRF_DIRECT_PINS_H
+
+#include <Arduino.h>
+
+// Compile-time pin map for the IRF H-bridge. Can be overridden from build_flags.
+// Defaults match the wiring in main.cpp: IRFMotorDriver irfMotor(MA1, MB2, MA2, MB1).
+#ifndef IRF_PIN_HIGH_A
+#define IRF_PIN_HIGH_A 5  // MA1, IRF9540A (PD5)
+#endif
+#ifndef IRF_PIN_HIGH_B
+#define IRF_PIN_HIGH_B 7  // MB2, IRF9540B (PD7)
+#endif
+#ifndef IRF_PIN_LOW_A
+#define IRF_PIN_LOW_A  6  // MA2, IRF540A  (PD6)
+#endif
+#ifndef IRF_PIN_LOW_B
+#define IRF_PIN_LOW_B  8  // MB1, IRF540B  (PB0)
+#endif
+
+// Arduino Nano (ATmega328P) pin -> port/bit mapping, resolved at compile time.
+// D0..D7 = PORTD, D8..D13 = PORTB, A0..A5 (14..19) = PORTC.
+#define IRF_PORT_B 0
+#define IRF_PORT_C 1
+#define IRF_PORT_D 2
+
+constexpr uint8_t irfPinPort(uint8_t pin) {
+    return pin < 8 ? IRF_PORT_D : (pin < 14 ? IRF_PORT_B : IRF_PORT_C);
+}
+
+constexpr uint8_t irfPinBit(uint8_t pin) {
+    return pin < 8 ? (1 << pin) : (pin < 14 ? (1 << (pin - 8)) : (1 << (pin - 14)));
+}
+
+// Pin levels per H-bridge state, one bit per device: HA, HB, LA, LB.
+// High side (IRF9540, P-channel) is ON when LOW, low side (IRF540) is ON when HIGH.
+// State numbering matches IRFMotorDriver::applyState():
+//   0 = idle (all off), 1 = right, 2 = left, 3 = e-break (both high sides on)
+#define IRF_LVL_HA 0x1
+#define IRF_LVL_HB 0x2
+#define IRF_LVL_LA 0x4
+#define IRF_LVL_LB 0x8
+
+constexpr uint8_t irfStateLevels(uint8_t s) {
+    return s == 0 ? (IRF_LVL_HA | IRF_LVL_HB) :  // idle
+           s == 1 ? (IRF_LVL_HB | IRF_LVL_LA) :  // right
+           s == 2 ? (IRF_LVL_HA | IRF_LVL_LB) :  // left
+                    0;                           // e-break
+}
+
+// Devices conducting in a state, same bit layout as the levels.
+// The high sides conduct on LOW, the low sides on HIGH.
+constexpr uint8_t irfStateOn(uint8_t s) {
+    return ((~irfStateLevels(s)) & (IRF_LVL_HA | IRF_LVL_HB)) | (irfStateLevels(s) & (IRF_LVL_LA | IRF_LVL_LB));
+}
+
+// The bridge legs are {HA, LB} and {HB, LA}: the diagonal HA+LA drives right, HB+LB drives left.
+// A set of conducting devices is safe if no leg has both of its devices in it.
+constexpr bool irfLegsSafe(uint8_t on) {
+    return !((on & IRF_LVL_HA) && (on & IRF_LVL_LB)) && !((on & IRF_LVL_HB) && (on & IRF_LVL_LA));
+}
+
+// Transition table. Pins of one state change in two port writes (or four digitalWrite calls), so
+// while moving a -> b any device of either state may be conducting: the hop is safe only if the
+// union is. Every change between two non-idle states goes through idle (state 0) with a dead time
+// in between. IRFMotorDriver::applyState() takes that decision from irfNeedsIdle(), so the checks
+// below cover the sequence the driver actually runs.
+constexpr bool irfNeedsIdle(uint8_t from, uint8_t to) {
+    return from != to && from != 0 && to != 0;
+}
+
+constexpr bool irfHopSafe(uint8_t a, uint8_t b) {
+    return irfLegsSafe(irfStateOn(a) | irfStateOn(b));
+}
+
+constexpr bool irfTransitionSafe(uint8_t from, uint8_t to) {
+    return irfNeedsIdle(from, to) ? irfHopSafe(from, 0) && irfHopSafe(0, to) : irfHopSafe(from, to);
+}
+
+constexpr bool irfAllTransitionsSafe(uint8_t i = 0) {
+    return i >= 16 ? true : irfTransitionSafe(i >> 2, i & 3) && irfAllTransitionsSafe(i + 1);
+}
+
+static_assert(irfAllTransitionsSafe(), "IRF state table enables both devices of a bridge leg");
+// Without the idle step, right <-> left and right/left -> e-break would short a leg.
+static_assert(!irfHopSafe(1, 2) && !irfHopSafe(1, 3) && !irfHopSafe(2, 3), "IRF leg map changed");
+// Reversals and brake changes go through all-off, so does the first state after power-up (255)
+static_assert(irfNeedsIdle(1, 2) && irfNeedsIdle(2, 1) && irfNeedsIdle(1, 3) && irfNeedsIdle(3, 2) &&
+              irfNeedsIdle(255, 1) && irfNeedsIdle(255, 2) && irfNeedsIdle(255, 3),
+              "IRF transition skips the idle step");
+
+/**
+ * Direct port backend for the 4 bridge pins.
+ * Every state becomes one masked write per port in use, with masks and values folded
+ * to constants at compile time. With the default wiring that is one PORTD write
+ * (in/andi/ori/out, 4 cycles) plus one sbi/cbi on PORTB (2 cycles).
+ *
+ * The writes are read-modify-write, so they must run with interrupts disabled
+ * (inside the ISR or a noInterrupts() section), which is how the driver calls them.
+ */
+template<uint8_t HA, uint8_t HB, uint8_t LA, uint8_t LB>
+struct IRFDirectPins {
+    static constexpr uint8_t bitOn(uint8_t pin, uint8_t port) {
+        return irfPinPort(pin) == port ? irfPinBit(pin) : 0;
+    }
+
+    static constexpr uint8_t mask(uint8_t port) {
+        return bitOn(HA, port) | bitOn(HB, port) | bitOn(LA, port) | bitOn(LB, port);
+    }
+
+    static constexpr uint8_t value(uint8_t port, uint8_t s) {
+        return ((irfStateLevels(s) & IRF_LVL_HA) ? bitOn(HA, port) : 0) |
+               ((irfStateLevels(s) & IRF_LVL_HB) ? bitOn(HB, port) : 0) |
+               ((irfStateLevels(s) & IRF_LVL_LA) ? bitOn(LA, port) : 0) |
+               ((irfStateLevels(s) & IRF_LVL_LB) ? bitOn(LB, port) : 0);
+    }
+
+    template<uint8_t S>
+    static inline void write() {
+        if (mask(IRF_PORT_D)) PORTD = (PORTD & (uint8_t)~mask(IRF_PORT_D)) | value(IRF_PORT_D, S);
+        if (mask(IRF_PORT_B)) PORTB = (PORTB & (uint8_t)~mask(IRF_PORT_B)) | value(IRF_PORT_B, S);
+        if (mask(IRF_PORT_C)) PORTC = (PORTC & (uint8_t)~mask(IRF_PORT_C)) | value(IRF_PORT_C, S);
+    }
+
+    static inline void write(uint8_t s) {
+        switch (s) {
+            case 0: write<0>(); break;
+            case 1: write<1>(); break;
+            case 2: write<2>(); break;
+            case 3: write<3>(); break;
+        }
+    }
+
+    static bool matches(uint8_t ha, uint8_t hb, uint8_t la, uint8_t lb) {
+        return ha == HA && hb == HB && la == LA && lb == LB;
+    }
+};
+
+typedef IRFDirectPins<IRF_PIN_HIGH_A, IRF_PIN_HIGH_B, IRF_PIN_LOW_A, IRF_PIN_LOW_B> IRFPins;
+
+#endif // IRF_DIRECT_PINS_H
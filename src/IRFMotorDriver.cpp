@@ -1,17 +1,93 @@
 #include "IRFMotorDriver.h"
+#include "Profiler.h"
+#include "IRFPhase.h"
 #include <avr/interrupt.h>
 
 IRFMotorDriver* _irfMotorInstance = nullptr;
 
+// PWM profiles indexed by IRF_PWM_*, see IRFMotorDriver.h for the resulting frequencies
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+static const IRFPwmProfile irfPwmProfiles[IRF_PWM_PROFILE_COUNT] PROGMEM = {
+    { (1 << CS10),  1,    IRF_T1_TOP + 1 },  // IRF_PWM_DEFAULT
+    { (1 << CS11),  8,    4000 },            // IRF_PWM_TORQUE
+    { (1 << CS10),  1,    IRF_T1_TOP + 1 },  // IRF_PWM_SMOOTH
+};
+#else
+static const IRFPwmProfile irfPwmProfiles[IRF_PWM_PROFILE_COUNT] PROGMEM = {
+    { (1 << CS22) | (1 << CS21),               256,  255 },  // IRF_PWM_DEFAULT
+    { (1 << CS22) | (1 << CS21) | (1 << CS20), 1024, 255 },  // IRF_PWM_TORQUE
+    { (1 << CS22) | (1 << CS21),               256,  31 },   // IRF_PWM_SMOOTH
+};
+#endif
+
+// PWM current ripple for the thermal model, in 0.01 A^2 per [profile][fast, slow decay]: the
+// I_rms^2 - I_avg^2 that tools/decay_sim.py gives at 50% duty (--pwm-hz 61/245/2016/500/20000),
+// scaled by 4 d (1 - d) for other duties. Fast decay is fitted at duty 0.2, where it peaks above
+// 0.1. The Timer1 backend always recirculates through the high side, both columns are its slow
+// decay.
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+static const uint16_t irfRippleA2[IRF_PWM_PROFILE_COUNT][2] PROGMEM = {
+    { 20,    20 },      // 20 kHz
+    { 17800, 17800 },   // 500 Hz
+    { 20,    20 },      // 20 kHz
+};
+#else
+static const uint16_t irfRippleA2[IRF_PWM_PROFILE_COUNT][2] PROGMEM = {
+    { 3300, 32600 },    // ~245 Hz
+    { 3000, 46500 },    // ~61 Hz, slow decay is not used here (IRF_SLOW_DECAY_MAX_PERIOD_US)
+    { 1400, 1800 },     // ~2 kHz
+};
+#endif
+
+// ISR cost with the direct port backend. The vector calls the out-of-line _isr(), so its prologue
+// saves SREG, r0, r1 and every call-clobbered register (r18-r27, r30, r31) whatever path runs.
+// An edge then does the flag tests, setPhaseTicks() (OCR2A store first, then the TCNT2 late
+// check), applyState() (one PORTD read-modify-write, PORTB sbi/cbi) and the hook test. The
+// digitalWrite() fallback costs far more per applyState(). Once per period preparePeriod() adds
+// the profile load, battery scale, slew limiter and dither plus the period hook, after the edge
+// is programmed and in the longer phase. Edges between two non-idle states (e-break, and every
+// edge in slow decay) add one more port write plus IRF_DEAD_TIME_CYCLES.
+// No cycle count is claimed here: read it from `avr-objdump -d` on the built ELF (<__vector_7>
+// and <IRFMotorDriver::_isr()>). The PROFILING build times PROF_PWM_ISR on target, without the
+// vector prologue and epilogue around the scope.
+#if IRF_PWM_BACKEND == IRF_PWM_SOFT_TIMER2
 ISR(TIMER2_COMPA_vect) {
+    PROFILE_SCOPE(PROF_PWM_ISR);
     if (_irfMotorInstance) {
         _irfMotorInstance->_isr();
     }
 }
+#else
+// Only enabled while the slew limiter is moving the duty
+ISR(TIMER1_OVF_vect) {
+    PROFILE_SCOPE(PROF_PWM_ISR);
+    if (_irfMotorInstance) {
+        _irfMotorInstance->_isr();
+    }
+}
+
+static_assert(IRF_PIN_LOW_A == 9 && IRF_PIN_LOW_B == 10,
+              "IRF_PWM_TIMER1 needs the IRF540 gates on OC1A (D9) and OC1B (D10)");
+#endif
 
 IRFMotorDriver::IRFMotorDriver(uint8_t pinHighA, uint8_t pinHighB, uint8_t pinLowA, uint8_t pinLowB) :
     _pinHighA(pinHighA), _pinHighB(pinHighB), _pinLowA(pinLowA), _pinLowB(pinLowB),
-    _currentPower(0.0f), _isEBreak(false), _timerOnTicks(0), _timerOffTicks(255), _isPwmHigh(false), _pwmPeriod(255), _appliedState(255)
+    _duty(0), _targetDuty(0), _slewDuty(0), _slewStep(0), _dwellTicks(0), _dwellCount(0),
+    _goalDuty(0), _slewMs(IRF_SLEW_MS), _dwellMs(IRF_REVERSE_DWELL_MS),
+    _vbatFiltered(0), _vbatScale(4096), _dutyLimit(IRF_DUTY_MAX), _vbatLimit(IRF_DUTY_MAX), _thermalLimit(IRF_DUTY_MAX),
+    _currentMa(0), _currentMeasured(false), _motorHeat(0), _fetHeat(0),
+    _isEBreak(false),
+    _timerOnTicks(0), _timerOffTicks(255), _activeState(1), _offState(0), _slowDecay(false), _activeOffState(0), _isPwmHigh(false),
+    _runOffTicks(0), _runOffState(0), _runCoast(false), _prepareLate(false), _pendingClock(0), _lateEdges(0),
+#if IRF_DITHER
+    _ditherAcc(0),
+#endif
+    _pwmPeriod(255), _profile(IRF_PWM_DEFAULT), _pendingProfile(255), _periodUs(IRF_SLEW_TICK_US), _slewDivider(1),
+    _periodHook(nullptr), _coastEnabled(false), _coastEvery(0), _coastTicks(0), _coastCount(0), _coastWindow(false),
+    _appliedState(255), _directPins(false)
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    , _hwCompare(0), _hwTop(IRF_T1_TOP), _slewDiv(0)
+#endif
 {
 }
 
@@ -20,10 +96,25 @@ void IRFMotorDriver::begin() {
     pinMode(_pinHighB, OUTPUT);
     pinMode(_pinLowA,  OUTPUT);
     pinMode(_pinLowB,  OUTPUT);
+    _directPins = IRFPins::matches(_pinHighA, _pinHighB, _pinLowA, _pinLowB);
     
     _irfMotorInstance = this;
+    setPwmProfile(IRF_PWM_DEFAULT);
     idle();
     
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    // Configure Timer1: fast PWM mode 14 (TOP = ICR1), clock from the profile, outputs disconnected
+    // until a direction is applied. OCR1x are double buffered and latch at BOTTOM.
+    noInterrupts();
+    TCCR1A = (1 << WGM11);
+    TCCR1B = (1 << WGM13) | (1 << WGM12);
+    TCNT1  = 0;
+    OCR1A  = 0;
+    OCR1B  = 0;
+    TIMSK1 = 0;
+    applyPwmProfile(_profile);
+    interrupts();
+#else
     // Configure Timer2
     noInterrupts();
     TCCR2A = 0;
@@ -39,7 +130,9 @@ void IRFMotorDriver::begin() {
     // 255 ticks = 16ms (roughly 60Hz PWM).
     // Let's use Prescaler 256 for smoother motor driving (16MHz/256 = 62.5kHz).
     // 255 ticks = 4ms (250Hz PWM).
-    TCCR2B |= (1 << CS22) | (1 << CS21); 
+    // The prescaler and period now come from the PWM profile (IRF_PWM_DEFAULT is the above).
+    applyPwmProfile(_profile);
+    startClock();
     
     // Start with a small default OFF period
     OCR2A = 100;
@@ -47,66 +140,331 @@ void IRFMotorDriver::begin() {
     // Enable CompA Interrupt
     TIMSK2 |= (1 << OCIE2A);
     interrupts();
+#endif
 }
 
 void IRFMotorDriver::idle() {
-    noInterrupts();
-    _currentPower = 0.0f;
+    uint8_t sreg = SREG;
+    cli();
+    _duty = 0;
     _isEBreak = false;
-    applyState(0);
-    interrupts();
+    resetSlew();
+    updateOutputs();
+    SREG = sreg;
 }
 
 void IRFMotorDriver::eBreak() {
-    noInterrupts();
-    _currentPower = 0.0f;
+    uint8_t sreg = SREG;
+    cli();
+    _duty = 0;
     _isEBreak = true;
-    applyState(0); // transition through idle
-    applyState(3); // hard break
+    resetSlew();
+    updateOutputs();
+    SREG = sreg;
+}
+
+void IRFMotorDriver::setDuty(int16_t duty) {
+    if (duty < -IRF_DUTY_MAX) duty = -IRF_DUTY_MAX;
+    
+    // Called from the control tick as well as from main: keep the caller's interrupt state
+    uint8_t sreg = SREG;
+    cli();
+    _duty = duty;
+    _targetDuty = duty;
+    _isEBreak = false;
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    TIMSK1 |= (1 << TOIE1); // Let the slew limiter run until it settles
+#endif
+    SREG = sreg;
+}
+
+int16_t IRFMotorDriver::getDuty() const {
+    uint8_t sreg = SREG;
+    cli();
+    int16_t duty = _duty;
+    SREG = sreg;
+    return duty;
+}
+
+void IRFMotorDriver::setSupplyVoltage(uint16_t mV) {
+    uint16_t scale = 4096;
+    int16_t limit = IRF_DUTY_MAX;
+    
+    if (mV < IRF_VBAT_PRESENT_MV) {
+        _vbatFiltered = 0;
+    } else {
+        if (_vbatFiltered == 0) _vbatFiltered = (uint32_t)mV << 4;
+        _vbatFiltered += (((int32_t)mV << 4) - (int32_t)_vbatFiltered) >> IRF_VBAT_FILTER_SHIFT;
+        uint16_t v = _vbatFiltered >> 4;
+        
+        uint32_t s = ((uint32_t)IRF_VBAT_NOMINAL_MV << 12) / v;
+        scale = s > 8192 ? 8192 : (uint16_t)s; // Never more than doubling the command
+        
+        if (v <= IRF_VBAT_CUTOFF_MV) {
+            limit = 0;
+        } else if (v < IRF_VBAT_TAPER_MV) {
+            limit = (int16_t)((uint32_t)IRF_DUTY_MAX * (v - IRF_VBAT_CUTOFF_MV) / (IRF_VBAT_TAPER_MV - IRF_VBAT_CUTOFF_MV));
+        }
+    }
+    _vbatLimit = limit;
+    applyLimits(scale);
+}
+
+// Publish the compensation scale and the lower of the battery and thermal limits to the ISR
+void IRFMotorDriver::applyLimits(uint16_t scale) {
+    int16_t limit = _vbatLimit < _thermalLimit ? _vbatLimit : _thermalLimit;
+    
+    // Small changes are filter noise, skip them so the Timer1 backend can stay interrupt free.
+    // Reaching zero power, full power or no compensation is always applied, so the limit cannot
+    // get stuck just short of either end after a cool-down or a recovering battery.
+    if (scale == _vbatScale && limit == _dutyLimit) return;
+    int16_t ds = (int16_t)(scale - _vbatScale);
+    int16_t dl = limit - _dutyLimit;
+    if (ds > -16 && ds < 16 && dl > -64 && dl < 64 &&
+        limit != 0 && limit != IRF_DUTY_MAX && scale != 4096) return;
+    
+    noInterrupts();
+    _vbatScale = scale;
+    _dutyLimit = limit;
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    TIMSK1 |= (1 << TOIE1); // Re-apply the duty with the new compensation
+#endif
     interrupts();
 }
 
-void IRFMotorDriver::setPower(float p) {
-    if (p < -100.0f) p = -100.0f;
-    if (p > 100.0f) p = 100.0f;
+void IRFMotorDriver::setPwmProfile(uint8_t profile) {
+    if (profile >= IRF_PWM_PROFILE_COUNT) return;
+    
+    IRFPwmProfile p;
+    memcpy_P(&p, &irfPwmProfiles[profile], sizeof(p));
+    // Software PWM phases last exactly their ticks (setPhaseTicks()), so a period is steps ticks
+    uint16_t periodUs = (uint16_t)((uint32_t)p.prescaler * p.steps / (F_CPU / 1000000UL));
     
     noInterrupts();
-    _currentPower = p;
-    _isEBreak = false;
-    calculateTimerTicks();
+    _profile = profile;
+    _periodUs = periodUs;
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    uint16_t div = IRF_SLEW_TICK_US / periodUs;
+    _slewDivider = div == 0 ? 1 : (div > 255 ? 255 : div);
+    _pendingProfile = profile;
+    TIMSK1 |= (1 << TOIE1); // Applied by the overflow interrupt at the period boundary
+#else
+    _slewDivider = 1;
+    _pendingProfile = profile;
+    updateCoastTiming(p);
+#endif
+    updateSlewTiming();
+    updateDecay();
+    interrupts();
+}
+
+void IRFMotorDriver::setCoastWindows(bool enable) {
+#if IRF_PWM_BACKEND != IRF_PWM_TIMER1
+    IRFPwmProfile p;
+    memcpy_P(&p, &irfPwmProfiles[_profile], sizeof(p));
+    
+    noInterrupts();
+    _coastEnabled = enable;
+    updateCoastTiming(p);
     interrupts();
+#endif
+}
+
+// Window spacing and length in periods and ticks of a profile. Called with interrupts disabled.
+void IRFMotorDriver::updateCoastTiming(const IRFPwmProfile& p) {
+    if (!_coastEnabled) {
+        _coastEvery = 0;
+        _coastWindow = false;
+        return;
+    }
+    uint16_t tickUs = p.prescaler / (F_CPU / 1000000UL);
+    uint16_t ticks = (IRF_BEMF_WINDOW_US + tickUs - 1) / tickUs;
+    _coastTicks = ticks >= p.steps ? p.steps - 1 : (uint8_t)ticks;
+    
+    uint16_t every = IRF_BEMF_INTERVAL_US / _periodUs;
+    _coastEvery = every == 0 ? 1 : (every > 255 ? 255 : every);
+}
+
+void IRFMotorDriver::setSlewTime(uint16_t ms) {
+    noInterrupts();
+    _slewMs = ms;
+    updateSlewTiming();
+    interrupts();
+}
+
+void IRFMotorDriver::setReversalDwell(uint16_t ms) {
+    noInterrupts();
+    _dwellMs = ms;
+    updateSlewTiming();
+    interrupts();
+}
+
+// Slew step and dwell length for the current slew tick. Called with interrupts disabled.
+void IRFMotorDriver::updateSlewTiming() {
+    uint32_t tickUs = (uint32_t)_periodUs * _slewDivider;
+    
+    uint32_t step = 0;
+    if (_slewMs > 0) {
+        step = (uint32_t)IRF_DUTY_MAX * tickUs / ((uint32_t)_slewMs * 1000);
+        if (step == 0) step = 1;
+        if (step > IRF_DUTY_MAX) step = 0; // Faster than one tick: no limit
+    }
+    _slewStep = (uint16_t)step;
+    
+    uint32_t ticks = ((uint32_t)_dwellMs * 1000 + tickUs - 1) / tickUs;
+    _dwellTicks = ticks > 255 ? 255 : (uint8_t)ticks;
+}
+
+// Load a profile into the PWM timer. Called from the ISR, for the software PWM while preparing
+// the first period that uses it, or from begin().
+void IRFMotorDriver::applyPwmProfile(uint8_t profile) {
+    IRFPwmProfile p;
+    memcpy_P(&p, &irfPwmProfiles[profile], sizeof(p));
+    _pendingProfile = 255;
+    
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    // ICR1 is not double buffered. Right after the overflow TCNT1 is close to BOTTOM, so the new
+    // TOP is never below the count.
+    _hwTop = p.steps - 1;
+    ICR1 = _hwTop;
+    TCCR1B = (TCCR1B & ~((1 << CS12) | (1 << CS11) | (1 << CS10))) | p.clockSelect;
+    calculateTimerTicks(_slewDuty);
+    updateOutputs();
+#else
+    // The ticks of the period being prepared use the new length right away, the prescaler
+    // follows at its start (startClock())
+    _pendingClock = p.clockSelect;
+    _pwmPeriod = (uint8_t)p.steps;
+#endif
+}
+
+void IRFMotorDriver::setDecay(uint8_t decay) {
+    noInterrupts();
+    _slowDecay = decay == IRF_DECAY_SLOW;
+    updateDecay();
+    interrupts();
+}
+
+// Off-phase state for the requested decay and the profile period, see
+// IRF_SLOW_DECAY_MAX_PERIOD_US. Called with interrupts disabled.
+void IRFMotorDriver::updateDecay() {
+    _offState = _slowDecay && _periodUs <= IRF_SLOW_DECAY_MAX_PERIOD_US ? 3 : 0;
+}
+
+void IRFMotorDriver::setPower(float p) {
+    setDuty(irfDuty(p / 100.0f));
 }
 
 // Backwards compatibility methods
 void IRFMotorDriver::SetPower(float speed) {
-    if (speed < -1.0f) speed = -1.0f;
-    if (speed > 1.0f) speed = 1.0f;
-    setPower(speed * 100.0f);
+    setDuty(irfDuty(speed));
 }
 
 void IRFMotorDriver::HardStop() {
     eBreak();
 }
 
+void IRFMotorDriver::setMotorCurrent(uint16_t mA) {
+    _currentMa = mA;
+    _currentMeasured = true;
+}
+
+int16_t IRFMotorDriver::getMotorTemperature() const {
+    return IRF_THERMAL_AMBIENT_C + (int16_t)(_motorHeat / 16000);
+}
+
+int16_t IRFMotorDriver::getFetTemperature() const {
+    return IRF_THERMAL_AMBIENT_C + (int16_t)(_fetHeat / 16000);
+}
+
+uint8_t IRFMotorDriver::getThermalLoad() const {
+    int32_t motor = _motorHeat / (IRF_MOTOR_MAX_RISE_C * 160L);
+    int32_t fet = _fetHeat / (IRF_FET_MAX_RISE_C * 160L);
+    int32_t load = motor > fet ? motor : fet;
+    return load > 255 ? 255 : (load < 0 ? 0 : (uint8_t)load);
+}
+
+// Maximum duty for a heat state: full up to IRF_THERMAL_DERATE_PCT of the allowed rise, then
+// linear down to IRF_THERMAL_FLOOR at the limit
+static int16_t irfThermalLimit(int32_t heat, int32_t maxRise) {
+    int32_t start = maxRise * IRF_THERMAL_DERATE_PCT / 100;
+    if (heat <= start) return IRF_DUTY_MAX;
+    if (heat >= maxRise) return IRF_THERMAL_FLOOR;
+    // In mC so the product fits 32 bits
+    int32_t over = (heat - start) >> 4;
+    int32_t span = (maxRise - start) >> 4;
+    return IRF_DUTY_MAX - (int16_t)((int32_t)(IRF_DUTY_MAX - IRF_THERMAL_FLOOR) * over / span);
+}
+
+// One step of both thermal RCs: heat += (I^2 x R x Rth - heat) / tau
+void IRFMotorDriver::thermalTick() {
+    noInterrupts();
+    int16_t d = _slewDuty;
+    interrupts();
+    uint16_t mag = d >= 0 ? d : -d;
+    uint16_t mA = _currentMa;
+    if (!_currentMeasured) {
+        mA = (uint16_t)((uint32_t)mag * IRF_THERMAL_LOAD_MA >> 15);
+    }
+    uint32_t dA = mA / 100;
+    uint32_t i2 = dA * dA; // 0.01 A^2. mA tops out at 65.5A, i2 x IRF_FET_RISE_PER_A2 fits 32 bits
+    
+    // Heating goes with I_rms^2 = I_avg^2 + ripple. Neither the estimate nor a shunt sample at the
+    // period start sees the ripple, which in slow decay at a low PWM frequency is the larger part.
+    uint16_t ripple = pgm_read_word(&irfRippleA2[_profile][_offState == 3 ? 1 : 0]);
+    uint32_t shape = (uint32_t)mag * (32768U - mag) >> 13; // 4 d (1 - d), Q15
+    i2 += (uint32_t)ripple * shape >> 15;
+    
+    int32_t motorTarget = (int32_t)(i2 * IRF_MOTOR_RISE_PER_A2 / 100) << 4;
+    int32_t fetTarget = (int32_t)(i2 * IRF_FET_RISE_PER_A2 / 100) << 4;
+    _motorHeat += (motorTarget - _motorHeat) >> IRF_MOTOR_TAU_SHIFT;
+    _fetHeat += (fetTarget - _fetHeat) >> IRF_FET_TAU_SHIFT;
+    
+    int16_t motorLimit = irfThermalLimit(_motorHeat, IRF_MOTOR_MAX_RISE_C * 16000L);
+    int16_t fetLimit = irfThermalLimit(_fetHeat, IRF_FET_MAX_RISE_C * 16000L);
+    _thermalLimit = motorLimit < fetLimit ? motorLimit : fetLimit;
+    applyLimits(_vbatScale);
+}
+
 float IRFMotorDriver::GetSpeed() const {
-    return _currentPower / 100.0f; // Scale back to -1.0 to 1.0
+    return getDuty() / (float)IRF_DUTY_MAX; // Scale back to -1.0 to 1.0
 }
 
 bool IRFMotorDriver::IsHardStopped() const {
-    return _isEBreak;
+    return _isEBreak; // One byte, no lock needed
 }
 
 void IRFMotorDriver::loop() {
-    // Left intentionally empty. Hardware timer automatically generates PWM.
+    // The hardware timer generates the PWM, only the thermal model runs here. The caller keeps
+    // the IRF_THERMAL_TICK_MS rate (the scheduler's thermal task), a second gate here would
+    // skip ticks whenever the two drift apart.
+    thermalTick();
 }
 
 
 
-void IRFMotorDriver::calculateTimerTicks() {
-    float p_abs = _currentPower >= 0 ? _currentPower : -_currentPower;
+// Compute the active period for an applied duty. Called from the ISR or with interrupts disabled.
+void IRFMotorDriver::calculateTimerTicks(int16_t duty) {
+    uint16_t mag = duty >= 0 ? duty : -duty;
+    if (duty > 0) _activeState = 1;
+    else if (duty < 0) _activeState = 2;
 
-    // Scale 0-100% directly to 0-255 timer ticks
-    uint16_t onTicks = (uint16_t)((p_abs / 100.0f) * _pwmPeriod);
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    _hwCompare = (uint16_t)(((uint32_t)mag * _hwTop + (IRF_DUTY_MAX / 2)) >> 15);
+#else
+#if IRF_DITHER
+    // First-order sigma-delta: exact ticks are mag * _pwmPeriod / 2^15, the remainder is fed
+    // back into the next period. Phases last exactly their tick count (setPhaseTicks()), so
+    // averaged over 2^15 / _pwmPeriod periods at worst the applied duty matches the Q1.15
+    // command. The sum stays below 256 << 15.
+    uint32_t exact = (uint32_t)mag * _pwmPeriod + _ditherAcc;
+    uint8_t onTicks = (uint8_t)(exact >> 15);
+    _ditherAcc = (uint16_t)exact & 0x7FFF;
+#else
+    // Scale 0..IRF_DUTY_MAX to 0.._pwmPeriod timer ticks on the top 8 bits, rounded up so
+    // full scale reaches _pwmPeriod. An 8x8 multiply keeps this cheap inside the ISR.
+    uint8_t onTicks = (uint8_t)(((uint16_t)(uint8_t)(mag >> 7) * _pwmPeriod + 255) >> 8);
+#endif
 
     if (onTicks == 0) {
         _timerOnTicks = 0;
@@ -115,56 +473,249 @@ void IRFMotorDriver::calculateTimerTicks() {
         _timerOnTicks = _pwmPeriod;
         _timerOffTicks = 0;
     } else {
-        _timerOnTicks = (uint8_t)onTicks;
-        _timerOffTicks = _pwmPeriod - _timerOnTicks;
+        _timerOnTicks = onTicks;
+        _timerOffTicks = _pwmPeriod - onTicks;
+    }
+#endif
+}
+
+// Push the applied state to the outputs. Called from the ISR or with interrupts disabled.
+void IRFMotorDriver::updateOutputs() {
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    uint8_t s = _isEBreak ? 3 : (_hwCompare == 0 ? 0 : _activeState);
+    if (s != _appliedState) {
+        // Everything off first: high sides released, low-side PORT bits LOW, then hand the
+        // low-side pins back from the compare units to PORT.
+        applyState(0);
+        TCCR1A &= ~((1 << COM1A1) | (1 << COM1B1));
+        __builtin_avr_delay_cycles(IRF_DEAD_TIME_CYCLES);
+        if (s == 1) {
+            OCR1A = _hwCompare;
+            TCCR1A |= (1 << COM1A1); // IRF540A PWM, non-inverting
+        } else if (s == 2) {
+            OCR1B = _hwCompare;
+            TCCR1A |= (1 << COM1B1); // IRF540B PWM, non-inverting
+        }
+        // High sides for the new state. The PWM'd low side is owned by OC1x, so its PORT bit does not matter.
+        applyState(s);
+    } else if (s == 1) {
+        OCR1A = _hwCompare; // Latched by hardware at the next BOTTOM, OCR1A == TOP is constant on
+    } else if (s == 2) {
+        OCR1B = _hwCompare;
+    }
+#else
+    // Only the stop states are applied here, everything else waits for the next period start.
+    if (_isEBreak || _timerOnTicks == 0) {
+        _isPwmHigh = false;
+        applyState(_isEBreak ? 3 : 0); // applyState() goes through idle for the hard break
     }
+#endif
 }
 
+// Break-before-make: a change between two non-idle states (or from the unknown power-up state)
+// first switches everything off and waits IRF_DEAD_TIME_US. The static_asserts on irfNeedsIdle()
+// in IRFDirectPins.h prove this sequence never enables both devices of a leg.
 void IRFMotorDriver::applyState(uint8_t s) {
     if (_appliedState == s) return;
+    if (irfNeedsIdle(_appliedState, s)) {
+        writePins(0);
+        __builtin_avr_delay_cycles(IRF_DEAD_TIME_CYCLES);
+    }
     _appliedState = s;
+    writePins(s);
+}
+
+void IRFMotorDriver::writePins(uint8_t s) {
+    if (_directPins) {
+        IRFPins::write(s);
+        return;
+    }
     if (s == 0) setPinsIdle();
     else if (s == 1) setPinsRight();
     else if (s == 2) setPinsLeft();
     else if (s == 3) setPinsEBreak();
 }
 
-void IRFMotorDriver::_isr() {
-    // 1. Check Full ON / Full OFF Overrides First
-    if (_isEBreak) {
-        applyState(3); // E-break
-        OCR2A = 255;   // Fire whenever, it doesn't matter, we're locked
+// Stop right away: drop the target and the ramp, no dwell. Called with interrupts disabled.
+void IRFMotorDriver::resetSlew() {
+    _targetDuty = 0;
+    _goalDuty = 0;
+    _slewDuty = 0;
+    _dwellCount = 0;
+    _activeOffState = _offState;
+#if IRF_DITHER
+    _ditherAcc = 0;
+#endif
+    calculateTimerTicks(0);
+}
+
+// One slew tick: latch the shadow target and decay mode, move the applied duty towards the target
+// by at most _slewStep, and route a sign flip through zero plus the reversal dwell.
+void IRFMotorDriver::latchShadow() {
+    _activeOffState = _offState;
+    
+    // Battery compensation and low-voltage limit
+    int32_t t = ((int32_t)_targetDuty * _vbatScale) >> 12;
+    int16_t limit = _dutyLimit;
+    if (t > limit) t = limit;
+    else if (t < -limit) t = -limit;
+    int16_t target = (int16_t)t;
+    _goalDuty = target;
+    
+    int16_t d = _slewDuty;
+    if (_dwellCount > 0) {
+        _dwellCount--;
         return;
     }
     
-    if (_timerOnTicks == 0) {
-        applyState(0); // Idle indefinitely
-        OCR2A = 255;
-        return;
+    bool flip = (d > 0 && target < 0) || (d < 0 && target > 0);
+    if (flip) target = 0;
+    
+    // Same sign or zero on both sides, so the difference fits in 16 bits
+    uint16_t step = _slewStep;
+    if (step == 0) {
+        d = target;
+    } else if (target > d) {
+        d = (uint16_t)(target - d) > step ? d + step : target;
+    } else if (target < d) {
+        d = (uint16_t)(d - target) > step ? d - step : target;
     }
     
-    if (_timerOffTicks == 0) {
-        applyState(_currentPower > 0 ? 1 : 2); // Full power indefinitely
-        OCR2A = 255;
+    if (flip && d == 0) _dwellCount = _dwellTicks;
+    _slewDuty = d;
+    calculateTimerTicks(d);
+}
+
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+// Timer1 overflow: pending profile change, then one slew tick every _slewDivider periods.
+// Disabled again once everything has settled.
+void IRFMotorDriver::_isr() {
+    if (_pendingProfile != 255) {
+        applyPwmProfile(_pendingProfile);
+    }
+    if (++_slewDiv < _slewDivider) return;
+    _slewDiv = 0;
+    
+    latchShadow();
+    updateOutputs();
+    if (_slewDuty == _goalDuty && _dwellCount == 0) {
+        TIMSK1 &= ~(1 << TOIE1);
+    }
+}
+#else
+// Every period is ON (_timerOnTicks) followed by OFF (_timerOffTicks). The interrupt that ends the
+// OFF phase, or the single interrupt of a full on/off period, is the period start. A phase can be a
+// single tick (256 cycles at /256), so both edges first program the next compare and the outputs
+// from values prepared earlier. The slow part, preparePeriod(), then runs in the longer phase of
+// the period and prepares the next one: a new duty or direction is latched once per period, takes
+// effect at a period start within two PWM periods, and a period is never torn.
+void IRFMotorDriver::_isr() {
+    // 1. E-break overrides everything
+    // Keep ticking at the profile period, so a duty after the brake is prepared and applied
+    // at period starts like any other
+    if (_isEBreak) {
+        if (_pendingProfile != 255) {
+            applyPwmProfile(_pendingProfile);
+        }
+        startClock();
+        setPhaseTicks(_pwmPeriod);
+        applyState(3); // E-break
+        if (_periodHook) _periodHook(IRF_PHASE_BRAKE);
         return;
     }
-
-    // 2. Fractional PWM Toggle Logic
+    
+    // 2. End of the ON phase: coast, or slow decay through the high sides.
+    // A back-EMF window always coasts so the terminals float.
     if (_isPwmHigh) {
-        // Currently ON. We need to turn OFF.
-        applyState(0);
-        OCR2A = _timerOffTicks;
+        setPhaseTicks(_runOffTicks);
         _isPwmHigh = false;
+        applyState(_runCoast ? 0 : _runOffState);
+        if (_runCoast && _periodHook) _periodHook(IRF_PHASE_COAST);
+        if (_prepareLate) {
+            _prepareLate = false;
+            preparePeriod();
+        }
+        return;
+    }
+    
+    // 3. Period start: run the prepared period
+    startClock();
+    uint8_t on = _timerOnTicks;
+    uint8_t off = _timerOffTicks;
+    if (on == 0) {
+        setPhaseTicks(_pwmPeriod);
+        applyState(0); // Idle for a full period
+    } else if (off == 0) {
+        setPhaseTicks(_pwmPeriod);
+        applyState(_activeState); // Full power for a full period
     } else {
-        // Currently OFF. We need to turn ON.
-        applyState(_currentPower > 0 ? 1 : 2);
-        OCR2A = _timerOnTicks;
+        // Fractional PWM: ON for on ticks. The OFF phase is kept aside, preparePeriod() may
+        // overwrite the prepared values before it starts.
+        setPhaseTicks(on);
+        applyState(_activeState);
         _isPwmHigh = true;
+        _runOffTicks = off;
+        _runOffState = _activeOffState;
+        _runCoast = _coastWindow;
+    }
+    if (_periodHook) {
+        _periodHook(IRF_PHASE_PERIOD);
+        if (on == 0 && _coastWindow) _periodHook(IRF_PHASE_COAST); // Coasting already
+    }
+    
+    // 4. Prepare the next period in whichever phase is longer
+    _prepareLate = _isPwmHigh && on < off;
+    if (!_prepareLate) preparePeriod();
+}
+
+// Switch profile if requested, latch and slew the next setpoint, and decide whether the next
+// period ends in a back-EMF window. Called once per period from the ISR.
+void IRFMotorDriver::preparePeriod() {
+    if (_pendingProfile != 255) {
+        applyPwmProfile(_pendingProfile);
+    }
+    latchShadow();
+    
+    // Every _coastEvery periods, end one in a back-EMF window of at least _coastTicks.
+    // latchShadow() recomputes the ticks every period, so the shortened ON phase does not stick.
+    _coastWindow = false;
+    if (_coastEvery != 0 && ++_coastCount >= _coastEvery) {
+        _coastCount = 0;
+        _coastWindow = true;
+        if (_timerOnTicks != 0 && _timerOffTicks < _coastTicks && _coastTicks < _pwmPeriod) {
+            _timerOnTicks = _pwmPeriod - _coastTicks;
+            _timerOffTicks = _coastTicks;
+        }
+    }
+}
+
+// Prescaler of a profile loaded by applyPwmProfile(), switched at the start of its first period
+void IRFMotorDriver::startClock() {
+    if (_pendingClock == 0) return;
+    TCCR2B = (TCCR2B & ~((1 << CS22) | (1 << CS21) | (1 << CS20))) | _pendingClock;
+    _pendingClock = 0;
+}
+
+// In CTC mode the compare match clears TCNT2 on the tick after it reaches OCR2A, so a phase of
+// n ticks is OCR2A = n - 1. Callers never pass 0: an empty ON or OFF phase is a single full
+// period instead (see calculateTimerTicks()).
+// An interrupt held off by another ISR can get here after TCNT2 has passed the new value. The
+// match would then be missed and the timer run on to 255 and wrap: up to 256 ticks of full on or
+// full off. Instead the count is moved back below the compare value, so the phase ends two ticks
+// from now (a TCNT2 write blocks the compare for one tick), and the late edge is counted.
+void IRFMotorDriver::setPhaseTicks(uint8_t ticks) {
+    uint8_t top = ticks - 1;
+    OCR2A = top;
+    if (TCNT2 > top) {
+        TCNT2 = irfLateCount(top); // Edge two timer clocks from now, also for a one-tick phase
+        _lateEdges++;
     }
 }
+#endif
 
 // Low-level pin toggles replicating the original functionality.
 // Writing to the outputs sequentially as original reference implementation.
+// Only used when the constructor pins differ from the compile-time map.
 
 void IRFMotorDriver::setPinsLeft() {
     digitalWrite(_pinHighA, HIGH);
@@ -2,6 +2,151 @@
 #define IRFMOTORDRIVER_H
 
 #include <Arduino.h>
+#include "IRFDirectPins.h"
+
+// PWM backend, select from build_flags with -DIRF_PWM_BACKEND=IRF_PWM_TIMER1
+//   IRF_PWM_SOFT_TIMER2: Timer2 CTC interrupt toggles the whole bridge (~245 Hz, 8-bit)
+//   IRF_PWM_TIMER1:      Timer1 fast PWM on the low-side gates (OC1A/OC1B), no ISR.
+//                        Needs IRF540A on D9 and IRF540B on D10 (see IRFDirectPins.h).
+#define IRF_PWM_SOFT_TIMER2 0
+#define IRF_PWM_TIMER1      1
+#ifndef IRF_PWM_BACKEND
+#define IRF_PWM_BACKEND IRF_PWM_SOFT_TIMER2
+#endif
+
+// Timer1 TOP (ICR1) at prescaler 1: 16MHz / (799 + 1) = 20kHz with 800 duty steps (~9.6 bits).
+// Use 1023 for a full 10 bits at 15.6kHz.
+#ifndef IRF_T1_TOP
+#define IRF_T1_TOP 799
+#endif
+
+// Break-before-make dead time between switching a bridge leg off and the opposite device on.
+// Busy-waited in cycles, so it must be a compile-time constant.
+#ifndef IRF_DEAD_TIME_US
+#define IRF_DEAD_TIME_US 2
+#endif
+#define IRF_DEAD_TIME_CYCLES ((uint32_t)IRF_DEAD_TIME_US * (F_CPU / 1000000UL))
+
+// Slew limit and reversal sequencing, run once per slew tick (one software PWM period, or a whole
+// number of Timer1 periods close to IRF_SLEW_TICK_US). IRF_SLEW_MS is the time to ramp
+// 0 -> full scale, IRF_REVERSE_DWELL_MS the time spent at zero when the sign of the duty flips.
+// Both can be changed at runtime, 0 disables. The defaults only take the edge off a full-power
+// reversal: -0.9 -> +0.4 costs ~37ms of a tap step, see TapCycle.
+#ifndef IRF_SLEW_MS
+#define IRF_SLEW_MS 20
+#endif
+#ifndef IRF_REVERSE_DWELL_MS
+#define IRF_REVERSE_DWELL_MS 5
+#endif
+#define IRF_SLEW_TICK_US 4096
+
+// Battery compensation (setSupplyVoltage()). The applied duty is scaled by nominal / filtered
+// battery voltage so the motor sees the same average voltage as the pack sags. Between the taper
+// and cutoff voltages the maximum duty is reduced linearly to zero. Readings below
+// IRF_VBAT_PRESENT_MV (USB power, no sense divider) disable both.
+#ifndef IRF_VBAT_NOMINAL_MV
+#define IRF_VBAT_NOMINAL_MV 18000
+#endif
+#ifndef IRF_VBAT_TAPER_MV
+#define IRF_VBAT_TAPER_MV 15000
+#endif
+#ifndef IRF_VBAT_CUTOFF_MV
+#define IRF_VBAT_CUTOFF_MV 14000
+#endif
+#define IRF_VBAT_PRESENT_MV 5000
+#define IRF_VBAT_FILTER_SHIFT 3  // IIR filter, time constant of 8 updates
+
+// I2t thermal model, stepped from loop() every IRF_THERMAL_TICK_MS. The motor winding and the two
+// conducting MOSFETs are each a first-order thermal RC heated by I^2 R. The current comes from
+// setMotorCurrent(), or without a current sensor is estimated as |duty| x IRF_THERMAL_LOAD_MA.
+// Both are average currents, so the PWM ripple of the active profile and decay mode is added to
+// I^2 from a table fitted to tools/decay_sim.py. Without a current sensor the model is an estimate
+// against a typical load, not protection against a stalled or overloaded motor.
+// Past IRF_THERMAL_DERATE_PCT of the allowed temperature rise, the maximum duty ramps down to
+// IRF_THERMAL_FLOOR at the limit.
+#define IRF_THERMAL_TICK_MS 16
+#define IRF_THERMAL_AMBIENT_C 25
+#ifndef IRF_THERMAL_LOAD_MA
+#define IRF_THERMAL_LOAD_MA 8000      // Typical drilling current at full duty
+#endif
+// Steady-state rise per A^2 (R x Rth) in mC, time constant as 2^shift ticks, allowed rise in C
+#ifndef IRF_MOTOR_RISE_PER_A2
+#define IRF_MOTOR_RISE_PER_A2 500     // 0.25 Ohm x 2 C/W
+#endif
+#define IRF_MOTOR_TAU_SHIFT 12        // ~65s
+#define IRF_MOTOR_MAX_RISE_C 80
+#ifndef IRF_FET_RISE_PER_A2
+#define IRF_FET_RISE_PER_A2 840       // IRF9540 + IRF540 on, 0.28 Ohm x 3 C/W on the heatsink
+#endif
+#define IRF_FET_TAU_SHIFT 10          // ~16s
+#define IRF_FET_MAX_RISE_C 100
+#define IRF_THERMAL_DERATE_PCT 75
+#define IRF_THERMAL_FLOOR 6554        // 20% duty at the limit
+
+// PWM profiles (setPwmProfile()), defined per backend in IRFMotorDriver.cpp:
+//                      Timer2 software PWM             Timer1 hardware PWM
+//   IRF_PWM_DEFAULT    /256,  255 steps, ~245 Hz       /1, 800 steps, 20 kHz
+//   IRF_PWM_TORQUE     /1024, 255 steps, ~61 Hz        /8, 4000 steps, 500 Hz
+//   IRF_PWM_SMOOTH     /256,   31 steps, ~2.0 kHz      /1, 800 steps, 20 kHz
+// The software PWM keeps a 16us or longer timer tick (256 cycles), higher frequencies come from
+// fewer steps and the dither restores the resolution. The shortest pulse is one tick: each edge
+// programs the next compare first thing in the ISR and the per-period work runs in the longer
+// phase, an edge delayed past its compare by other interrupts is caught and counted
+// (getLateEdges()).
+#define IRF_PWM_DEFAULT 0
+#define IRF_PWM_TORQUE  1  // Low frequency, strong pulses (tapping)
+#define IRF_PWM_SMOOTH  2  // High frequency, smoother and quieter (manual drilling)
+#define IRF_PWM_PROFILE_COUNT 3
+
+struct IRFPwmProfile {
+    uint8_t clockSelect;  // CSx2:0 bits of the PWM timer
+    uint16_t prescaler;   // Divider selected by clockSelect
+    uint16_t steps;       // Timer ticks per period: Timer2 up to 255, Timer1 ICR1 + 1
+};
+
+// Sigma-delta dithering of the software PWM duty: the fraction of a timer tick that does not fit in
+// this period is carried into the next one, so the average duty keeps the full 15 bits of Q1.15
+// instead of 8. Costs one 16x16 multiply per period, no extra interrupts.
+#ifndef IRF_DITHER
+#define IRF_DITHER 1
+#endif
+
+// Back-EMF measurement windows (setCoastWindows()), software PWM only. Roughly every
+// IRF_BEMF_INTERVAL_US one period coasts for at least IRF_BEMF_WINDOW_US, shortening its ON phase
+// if needed, so the motor terminals settle to the back-EMF and can be sampled. Costs ~2% of the
+// maximum torque. The Timer1 backend never lets the terminals float and has no windows.
+#ifndef IRF_BEMF_INTERVAL_US
+#define IRF_BEMF_INTERVAL_US 16000
+#endif
+#ifndef IRF_BEMF_WINDOW_US
+#define IRF_BEMF_WINDOW_US 352  // Current decay plus three ADC conversions
+#endif
+
+// Phase passed to the period hook
+#define IRF_PHASE_PERIOD 0  // Period start, setpoint just latched
+#define IRF_PHASE_COAST  1  // Start of a back-EMF measurement window, bridge all off
+#define IRF_PHASE_BRAKE  2  // Period start during e-break, instead of IRF_PHASE_PERIOD: no windows
+
+// Off-phase behaviour of the software PWM (setDecay())
+#define IRF_DECAY_FAST 0  // Off phase coasts (all off), current decays through the body diodes
+#define IRF_DECAY_SLOW 1  // Off phase shorts the motor through both high sides, like eBreak()
+
+// Longest PWM period slow decay is used with. The winding time constant is ~0.4ms, so in slow
+// decay a longer period lets the current swing through most of its range every period: at 61 Hz
+// tools/decay_sim.py gives 17-22 A RMS for ~1.7 A average (fast decay 2-5 A), at ~2 kHz 3-4.6 A.
+// Profiles with a longer period run fast decay whatever setDecay() asked for.
+#define IRF_SLOW_DECAY_MAX_PERIOD_US 512
+
+// Signed Q1.15 duty used from the modes down to the ISR:
+// -IRF_DUTY_MAX = full reverse (left), +IRF_DUTY_MAX = full forward (right).
+#define IRF_DUTY_MAX 32767
+
+// Float (-1.0..1.0) to Q1.15. constexpr so tables like TapConfig fold at compile time.
+constexpr int16_t irfDuty(float f) {
+    return f >= 1.0f ? IRF_DUTY_MAX :
+           f <= -1.0f ? -IRF_DUTY_MAX :
+           (int16_t)(f * IRF_DUTY_MAX + (f >= 0 ? 0.5f : -0.5f));
+}
 
 class IRFMotorDriver {
 public:
@@ -11,6 +156,9 @@ public:
      * @param pinHighB Pin for high-side B (IRF9540B), originally MB2
      * @param pinLowA  Pin for low-side A  (IRF540A), originally MA2
      * @param pinLowB  Pin for low-side B  (IRF540B), originally MB1
+     *
+     * If the pins match the compile-time map in IRFDirectPins.h the driver writes the
+     * port registers directly, otherwise it falls back to digitalWrite().
      */
     IRFMotorDriver(uint8_t pinHighA, uint8_t pinHighB, uint8_t pinLowA, uint8_t pinLowB);
     
@@ -23,7 +171,58 @@ public:
     // Hard break shorting the motor
     void eBreak();
     
-    // Set power from -100.0 (Reverse/Left) to +100.0 (Forward/Right)
+    // Set duty in Q1.15, -IRF_DUTY_MAX (Reverse/Left) to +IRF_DUTY_MAX (Forward/Right).
+    // The applied duty follows it at the slew limit, and a sign flip ramps down to zero,
+    // coasts for the reversal dwell and then ramps up the other way.
+    void setDuty(int16_t duty);
+    int16_t getDuty() const;
+    
+    // Switch to one of the IRF_PWM_* profiles. Applied at the next period boundary so the
+    // running period is never cut short; duty, slew rate and dwell carry over.
+    void setPwmProfile(uint8_t profile);
+    uint8_t getPwmProfile() const { return _profile; }
+    uint16_t getPwmPeriodUs() const { return _periodUs; }
+    // Software PWM edges that were programmed after the timer had passed the compare value and
+    // ran a tick or two long (see setPhaseTicks()). Stays 0 while the ISR keeps up.
+    uint16_t getLateEdges() const { noInterrupts(); uint16_t n = _lateEdges; interrupts(); return n; }
+    
+    // Feed a battery reading in mV, e.g. every 10ms. Filtered, then used to compensate the duty
+    // and taper the maximum power near cutoff.
+    void setSupplyVoltage(uint16_t mV);
+    uint16_t getSupplyVoltage() const { return _vbatFiltered >> 4; }  // Filtered, in mV
+    int16_t getDutyLimit() const { return _dutyLimit; }  // Battery and thermal, Q1.15
+    
+    // Feed a measured motor current in mA for the thermal model, e.g. every 10ms. Without it the
+    // model estimates the current from the duty.
+    void setMotorCurrent(uint16_t mA);
+    int16_t getMotorTemperature() const;  // Estimated, in C
+    int16_t getFetTemperature() const;
+    // Hottest of motor and MOSFETs in % of its allowed rise, derating starts at IRF_THERMAL_DERATE_PCT
+    uint8_t getThermalLoad() const;
+    int16_t getThermalLimit() const { return _thermalLimit; }
+    
+    // Function called from the software PWM ISR at every period start (after the setpoint is
+    // latched) with IRF_PHASE_PERIOD (IRF_PHASE_BRAKE during e-break), and at the start of every
+    // back-EMF window with IRF_PHASE_COAST, e.g. AnalogSampler::pwmTrigger. Keep it short. Not called by the Timer1 backend.
+    void setPeriodHook(void (*hook)(uint8_t phase)) { _periodHook = hook; }
+    
+    // Enable the periodic back-EMF measurement windows (see IRF_BEMF_INTERVAL_US)
+    void setCoastWindows(bool enable);
+    
+    // Time to ramp from 0 to full scale in ms, 0 = no slew limit
+    void setSlewTime(uint16_t ms);
+    // Time spent coasting at zero before reversing in ms, 0 = reverse right away
+    void setReversalDwell(uint16_t ms);
+    
+    // Select IRF_DECAY_FAST or IRF_DECAY_SLOW, latched with the next period.
+    // Slow decay keeps current flowing in the off phase: more torque at low duty and a near
+    // linear speed-vs-duty curve. It only takes effect while the PWM profile's period is at most
+    // IRF_SLOW_DECAY_MAX_PERIOD_US, getDecay() returns what is used. The Timer1 backend always
+    // recirculates through the held high side and ignores this.
+    void setDecay(uint8_t decay);
+    uint8_t getDecay() const { return _offState == 3 ? IRF_DECAY_SLOW : IRF_DECAY_FAST; }
+    
+    // Set power from -100.0 (Reverse/Left) to +100.0 (Forward/Right). Wraps setDuty().
     void setPower(float p);
     
     // BACKWARDS COMPATIBILITY METHODS
@@ -32,7 +231,9 @@ public:
     void HardStop();
     float GetSpeed() const;
     bool IsHardStopped() const;
-    void loop(); // Empty stub for backwards compatibility
+    // Bridge state the outputs are in: 0 idle, 1 right, 2 left, 3 e-break (or not applied yet)
+    uint8_t getBridgeState() const { return _appliedState & 0x03; }
+    void loop(); // Steps the thermal model, call every IRF_THERMAL_TICK_MS
     
     // Internal method called by ISR
     void _isr();
@@ -43,19 +244,83 @@ private:
     uint8_t _pinLowA;
     uint8_t _pinLowB;
     
-    volatile float _currentPower;
+    volatile int16_t _duty;         // Commanded duty, set from the control tick and from main
+    volatile int16_t _targetDuty;   // Shadow of _duty, latched by the ISR once per period
+    volatile int16_t _slewDuty;     // Applied duty after slew limiting, owned by the ISR
+    volatile uint16_t _slewStep;    // Max duty change per slew tick, 0 = unlimited
+    volatile uint8_t _dwellTicks;   // Slew ticks to coast at zero on a reversal
+    volatile uint8_t _dwellCount;
+    volatile int16_t _goalDuty;     // _targetDuty after supply compensation, owned by the ISR
+    uint16_t _slewMs;
+    uint16_t _dwellMs;
+    
+    uint32_t _vbatFiltered;         // mV << 4
+    volatile uint16_t _vbatScale;   // Nominal / actual, Q4.12
+    volatile int16_t _dutyLimit;    // Max |duty| allowed, Q1.15, the lower of the two below
+    int16_t _vbatLimit;             // Max |duty| allowed by the battery
+    int16_t _thermalLimit;          // Max |duty| allowed by the thermal model
+    
+    // Thermal model, main context only
+    uint16_t _currentMa;
+    bool _currentMeasured;
+    int32_t _motorHeat;             // Rise over ambient, mC << 4
+    int32_t _fetHeat;
     volatile bool _isEBreak;
     
+    // Next period as prepared by the ISR (current one for the Timer1 backend)
     volatile uint8_t _timerOnTicks;
     volatile uint8_t _timerOffTicks;
+    volatile uint8_t _activeState;  // 1 = right, 2 = left, for the prepared period
+    volatile uint8_t _offState;     // Off-phase state: 0 = coast, 3 = slow decay
+    bool _slowDecay;                // Slow decay requested, _offState also depends on the profile
+    volatile uint8_t _activeOffState;
     volatile bool _isPwmHigh;
+    uint8_t _runOffTicks;           // OFF phase of the running period, prepared values may be newer
+    uint8_t _runOffState;
+    bool _runCoast;
+    bool _prepareLate;              // Prepare the next period at the end of the ON phase
+    uint8_t _pendingClock;          // Prescaler bits for the next period start, 0 = unchanged
+    volatile uint16_t _lateEdges;
+#if IRF_DITHER
+    uint16_t _ditherAcc;            // Carried fraction of a tick, Q0.15, owned by the ISR
+#endif
     
-    // We target ~1kHz PWM, so with a 15.6kHz timer clock (prescaler 1024), 1 period = ~255 ticks for max resolution.
+    // Period in timer ticks and time for the active profile. Up to 255 ticks with prescaler 256
+    // (62.5kHz timer clock) for the default ~4ms period.
     uint8_t _pwmPeriod;
+    uint8_t _profile;
+    volatile uint8_t _pendingProfile;  // 255 = none, applied by the ISR at the period boundary
+    uint16_t _periodUs;
+    uint8_t _slewDivider;              // PWM periods per slew tick
+    void (*_periodHook)(uint8_t phase);
+    bool _coastEnabled;
+    volatile uint8_t _coastEvery;      // Periods between back-EMF windows, 0 = off
+    volatile uint8_t _coastTicks;      // Minimum OFF ticks of a window
+    uint8_t _coastCount;
+    volatile bool _coastWindow;        // The running period ends in a back-EMF window
     uint8_t _appliedState;
+    bool _directPins;
+#if IRF_PWM_BACKEND == IRF_PWM_TIMER1
+    uint16_t _hwCompare;  // OCR1A/OCR1B value, 0..ICR1
+    uint16_t _hwTop;      // ICR1 of the active profile
+    uint8_t _slewDiv;     // Overflow count within the current slew tick
+#endif
 
     void applyState(uint8_t s);
-    void calculateTimerTicks();
+    void writePins(uint8_t s);
+    void calculateTimerTicks(int16_t duty);
+    void preparePeriod();
+    void startClock();
+    void setPhaseTicks(uint8_t ticks);
+    void updateOutputs();
+    void latchShadow();
+    void resetSlew();
+    void applyPwmProfile(uint8_t profile);
+    void updateSlewTiming();
+    void updateDecay();
+    void updateCoastTiming(const IRFPwmProfile& p);
+    void applyLimits(uint16_t scale);
+    void thermalTick();
     void setPinsRight();
     void setPinsLeft();
     void setPinsIdle();
@@ -0,0 +1,21 @@
+#ifndef IRF_PHASE_H
+#define IRF_PHASE_H
+
+#include <stdint.h>
+
+/**
+ * Late-edge recovery for the Timer2 software PWM (IRFMotorDriver::setPhaseTicks()). Plain integer
+ * code, so tools/phase_sim.cpp can run it against a model of the CTC counter on the host.
+ *
+ * A phase of n ticks is OCR2A = n - 1. When the ISR stores that after TCNT2 has already passed
+ * it, the counter would run a 256 tick lap to the next match. irfLateCount() is the TCNT2 value
+ * that ends the phase on the second timer clock after the write instead. A TCNT2 write blocks the
+ * compare match on the next clock, and in CTC mode the clear with it, so the value must not be
+ * OCR2A itself: a one-tick phase (top 0) restarts from 255, which rolls over to 0 and matches on
+ * the clock after.
+ */
+inline uint8_t irfLateCount(uint8_t top) {
+    return top == 0 ? 255 : top - 1;
+}
+
+#endif // IRF_PHASE_H
@@ -0,0 +1,103 @@
+#ifndef KNOB_CURVES_H
+#define KNOB_CURVES_H
+
+#include <Arduino.h>
+#include "AnalogSampler.h"
+#include "IRFMotorDriver.h"
+
+// Knob response curves. Each one is a 256-entry flash table built at compile time, indexed by
+// the top 8 bits of the 12-bit knob code, so a knob read is a single pgm_read_byte().
+#define KNOB_CURVE_STEPPED 0  // 7 levels with a 1.5 power remap, the original readKnobFraction()
+#define KNOB_CURVE_LINEAR  1  // Linear from the 1.5V dead band to 4.5V
+#define KNOB_CURVE_EXPO    2  // RC style expo (25% linear + 75% cubic), fine control at the low end
+#define KNOB_CURVE_COUNT   3
+
+#ifndef KNOB_CURVE
+#define KNOB_CURVE KNOB_CURVE_STEPPED
+#endif
+
+// Dead band below KNOB_V_MIN, full scale from KNOB_V_MAX
+#define KNOB_V_MIN 1.50f
+#define KNOB_V_MAX 4.50f
+
+// Voltage at the centre of table entry i (16 codes of the 12-bit scale per entry)
+constexpr float knobVolts(uint8_t i) {
+    return (i * 16 + 8) * 5.0f / ANALOG_FULL_SCALE;
+}
+
+constexpr uint8_t knobByte(float f) {
+    return f <= 0.0f ? 0 : (f >= 1.0f ? 255 : (uint8_t)(f * 255.0f + 0.5f));
+}
+
+// --- Stepped: levels {1.5, 1.6, 1.8, 2.1, 2.7, 3.6, 4.5, 5.0}, step n when below 80% of the way to level n
+constexpr float knobStepLevel(uint8_t n) {
+    return n == 0 ? 1.50f : n == 1 ? 1.60f : n == 2 ? 1.80f : n == 3 ? 2.10f :
+           n == 4 ? 2.70f : n == 5 ? 3.60f : n == 6 ? 4.50f : 5.00f;
+}
+
+constexpr float knobStepTransition(uint8_t n) {
+    return knobStepLevel(n) - (knobStepLevel(n) - knobStepLevel(n - 1)) * 0.2f;
+}
+
+constexpr uint8_t knobStepIndex(float v, uint8_t n = 1) {
+    return n > 6 ? 6 : (v < knobStepTransition(n) ? n : knobStepIndex(v, n + 1));
+}
+
+// (n / 6) ^ 1.5, precomputed because powf() is not constexpr
+constexpr float knobStepFraction(uint8_t n) {
+    return n == 1 ? 0.06804f : n == 2 ? 0.19245f : n == 3 ? 0.35355f :
+           n == 4 ? 0.54433f : n == 5 ? 0.76073f : 1.0f;
+}
+
+constexpr uint8_t knobStepped(uint8_t i) {
+    return knobVolts(i) <= KNOB_V_MIN ? 0 :
+           knobVolts(i) >= KNOB_V_MAX ? 255 :
+           knobByte(knobStepFraction(knobStepIndex(knobVolts(i))));
+}
+
+// --- Linear and expo
+constexpr float knobSpan(uint8_t i) {
+    return (knobVolts(i) - KNOB_V_MIN) / (KNOB_V_MAX - KNOB_V_MIN);
+}
+
+constexpr uint8_t knobLinear(uint8_t i) {
+    return knobVolts(i) <= KNOB_V_MIN ? 0 : knobByte(knobSpan(i));
+}
+
+constexpr float knobExpoOf(float x) {
+    return x >= 1.0f ? 1.0f : 0.25f * x + 0.75f * x * x * x;
+}
+
+constexpr uint8_t knobExpo(uint8_t i) {
+    return knobVolts(i) <= KNOB_V_MIN ? 0 : knobByte(knobExpoOf(knobSpan(i)));
+}
+
+// Compile-time index list 0..255 to expand the tables
+template<uint8_t... I> struct KnobIndex {};
+template<uint16_t N, uint8_t... I> struct KnobMakeIndex : KnobMakeIndex<N - 1, N - 1, I...> {};
+template<uint8_t... I> struct KnobMakeIndex<0, I...> { typedef KnobIndex<I...> type; };
+
+template<typename Index> struct KnobTables;
+template<uint8_t... I> struct KnobTables<KnobIndex<I...> > {
+    static const uint8_t data[KNOB_CURVE_COUNT][256];
+};
+
+template<uint8_t... I>
+const uint8_t KnobTables<KnobIndex<I...> >::data[KNOB_CURVE_COUNT][256] PROGMEM = {
+    { knobStepped(I)... },
+    { knobLinear(I)... },
+    { knobExpo(I)... },
+};
+
+typedef KnobTables<KnobMakeIndex<256>::type> KnobTable;
+
+static_assert(knobStepped(0) == 0 && knobStepped(255) == 255, "Stepped curve end points");
+static_assert(knobLinear(76) == 0 && knobLinear(255) == 255, "Linear curve end points");
+
+// Knob fraction in Q1.15 (0..IRF_DUTY_MAX) for a 12-bit knob code
+inline int16_t knobLookup(uint8_t curve, uint16_t code) {
+    uint8_t v = pgm_read_byte(&KnobTable::data[curve][code >> 4]);
+    return (int16_t)(((uint16_t)v << 7) | (v >> 1)); // 255 -> 32767
+}
+
+#endif // KNOB_CURVES_H
@@ -0,0 +1,162 @@
+#include "Logger.h"
+#include <avr/interrupt.h>
+
+Logger logger;
+
+// Record: [level << 3 | argc] [format address, 2 bytes] [argc x int32, little endian]
+#define LOG_HEADER_BYTES 3
+
+Logger::Logger() : _head(0), _tail(0), _dropped(0), _reported(0) {
+}
+
+void Logger::put(uint8_t level, const char* fmt, uint8_t argc, const int32_t* args) {
+    uint16_t f = (uint16_t)(uintptr_t)fmt;
+    uint8_t n = LOG_HEADER_BYTES + 4 * argc;
+
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t h = _head;
+    uint8_t used = (uint8_t)((h + LOG_RING_SIZE - _tail) % LOG_RING_SIZE);
+    if (LOG_RING_SIZE - 1 - used < n) {
+        _dropped++;
+        SREG = sreg;
+        return;
+    }
+    _ring[h] = (level << 3) | argc;
+    h = (h + 1) % LOG_RING_SIZE;
+    _ring[h] = f & 0xFF;
+    h = (h + 1) % LOG_RING_SIZE;
+    _ring[h] = f >> 8;
+    h = (h + 1) % LOG_RING_SIZE;
+    for (uint8_t i = 0; i < argc; i++) {
+        uint32_t v = (uint32_t)args[i];
+        for (uint8_t b = 0; b < 4; b++) {
+            _ring[h] = (uint8_t)(v >> (8 * b));
+            h = (h + 1) % LOG_RING_SIZE;
+        }
+    }
+    asm volatile("" ::: "memory"); // _ring is not volatile, store it before publishing _head
+    _head = h;
+    SREG = sreg;
+}
+
+uint16_t Logger::getDropCount() const {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t dropped = _dropped;
+    SREG = sreg;
+    return dropped;
+}
+
+bool Logger::drain(HardwareSerial& out) {
+    bool sent = false;
+    char line[LOG_LINE_MAX];
+
+    while (_tail != _head) {
+        // Only the consumer moves _tail, so the record can be read without a lock, after _head
+        asm volatile("" ::: "memory");
+        uint8_t t = _tail;
+        uint8_t hdr = _ring[t];
+        t = (t + 1) % LOG_RING_SIZE;
+        uint16_t f = _ring[t];
+        t = (t + 1) % LOG_RING_SIZE;
+        f |= (uint16_t)_ring[t] << 8;
+        t = (t + 1) % LOG_RING_SIZE;
+        uint8_t argc = hdr & 0x07;
+        int32_t args[LOG_MAX_ARGS];
+        for (uint8_t i = 0; i < argc; i++) {
+            uint32_t v = 0;
+            for (uint8_t b = 0; b < 4; b++) {
+                v |= (uint32_t)_ring[t] << (8 * b);
+                t = (t + 1) % LOG_RING_SIZE;
+            }
+            args[i] = (int32_t)v;
+        }
+
+        uint8_t len = format(line, hdr >> 3, (const char*)(uintptr_t)f, argc, args);
+        if (out.availableForWrite() < len) break; // Try again next idle pass
+        out.write((const uint8_t*)line, len);
+        asm volatile("" ::: "memory");
+        _tail = t;
+        sent = true;
+    }
+    if (_tail != _head) return sent;
+
+    // A full ring drops the newest records, so the gap is after everything queued
+    noInterrupts();
+    uint16_t dropped = _dropped;
+    interrupts();
+    if (dropped != _reported) {
+        int32_t a = (uint16_t)(dropped - _reported);
+        uint8_t len = format(line, LOG_LEVEL_WARN, PSTR("%u log records dropped"), 1, &a);
+        if (out.availableForWrite() < len) return sent;
+        out.write((const uint8_t*)line, len);
+        _reported = dropped;
+        sent = true;
+    }
+    return sent;
+}
+
+// Digits of v into p, returns the count. Base 10 or 16.
+static uint8_t logNumber(char* p, uint32_t v, uint8_t base) {
+    char tmp[10];
+    uint8_t n = 0;
+    do {
+        uint8_t d = v % base;
+        tmp[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+        v /= base;
+    } while (v != 0);
+    for (uint8_t i = 0; i < n; i++) p[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// Render one record as a line ending in CRLF, cut to LOG_LINE_MAX
+uint8_t Logger::format(char* line, uint8_t level, const char* fmt, uint8_t argc, const int32_t* args) const {
+    const uint8_t room = LOG_LINE_MAX - 2; // CRLF
+    uint8_t n = 0;
+    if (level == LOG_LEVEL_ERROR) { line[n++] = 'E'; line[n++] = ':'; line[n++] = ' '; }
+    else if (level == LOG_LEVEL_WARN) { line[n++] = 'W'; line[n++] = ':'; line[n++] = ' '; }
+
+    uint8_t next = 0;
+    for (;;) {
+        char c = pgm_read_byte(fmt++);
+        if (c == 0 || n >= room) break;
+        if (c != '%') {
+            line[n++] = c;
+            continue;
+        }
+        c = pgm_read_byte(fmt++);
+        if (c == 0) break;
+        if (c == '%') {
+            line[n++] = '%';
+            continue;
+        }
+        int32_t v = next < argc ? args[next++] : 0;
+        if ((c == 'd' || c == 'u' || c == 'x') && n + 11 > room) break; // Sign and 10 digits
+        if (c == 'd') {
+            if (v < 0) {
+                line[n++] = '-';
+                n += logNumber(line + n, -(uint32_t)v, 10);
+            } else {
+                n += logNumber(line + n, v, 10);
+            }
+        } else if (c == 'u') {
+            n += logNumber(line + n, (uint32_t)v, 10);
+        } else if (c == 'x') {
+            n += logNumber(line + n, (uint32_t)v, 16);
+        } else if (c == 'c') {
+            line[n++] = (char)v;
+        } else if (c == 's' || c == 'S') {
+            const char* s = (const char*)(uintptr_t)v;
+            while (s && n < room) {
+                char sc = c == 'S' ? pgm_read_byte(s) : *s;
+                if (sc == 0) break;
+                line[n++] = sc;
+                s++;
+            }
+        }
+    }
+    line[n++] = '\r';
+    line[n++] = '\n';
+    return n;
+}
@@ -0,0 +1,116 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+
+// Levels, messages above LOG_LEVEL are compiled out
+#define LOG_LEVEL_OFF   0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Modules, a message is compiled in only if its module bit is set in LOG_MODULES
+#define LOG_MAIN  0x01  // Serial commands and status in main.cpp
+#define LOG_MOTOR 0x02  // Motor drivers
+#define LOG_MODE  0x04  // Drill modes
+#define LOG_SENSE 0x08  // Current, stall and battery sensing
+#ifndef LOG_MODULES
+#define LOG_MODULES 0xFF
+#endif
+
+// Record ring in bytes. A record is 3 bytes plus 4 per argument.
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 128
+#endif
+#define LOG_MAX_ARGS 5
+#define LOG_LINE_MAX 60  // Below the 64 byte HardwareSerial TX buffer, or a line could never go out
+
+/**
+ * Deferred logging: the call site stores a binary record, formatting and sending happen later.
+ *
+ * LOG_INFO(LOG_MAIN, "Knob curve: %u", knobCurve) keeps the format string in flash and appends
+ * its address, the level and up to LOG_MAX_ARGS arguments (as 32-bit integers) to a ring, a few
+ * dozen cycles with interrupts briefly off, so it is safe from the control tick and ISRs.
+ * drain() formats records in loop()'s idle time and hands each line to Serial only when its TX
+ * buffer has room for all of it, so logging never waits for the UART. A full ring drops the new
+ * record; once the queued lines are out, one more reports how many were lost.
+ *
+ * Formats: %d %u %x (integers), %c, %s (string in RAM, e.g. a mode name), %S (string in flash),
+ * %%. Strings are stored as pointers and must outlive the record. No floats, scale them first.
+ */
+class Logger {
+public:
+    Logger();
+
+    template <typename... A>
+    void log(uint8_t level, const char* fmt, A... args) {
+        static_assert(sizeof...(A) <= LOG_MAX_ARGS, "too many log arguments");
+        int32_t a[] = { arg(args)... };
+        put(level, fmt, sizeof...(A), a);
+    }
+    void log(uint8_t level, const char* fmt) {
+        put(level, fmt, 0, nullptr);
+    }
+
+    // Format and send queued records while Serial can take whole lines. Returns true if
+    // anything was sent.
+    bool drain(HardwareSerial& out);
+
+    uint16_t getDropCount() const;
+
+private:
+    uint8_t _ring[LOG_RING_SIZE];
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+    volatile uint16_t _dropped;
+    uint16_t _reported;             // Drops already reported by drain()
+
+    template <typename T>
+    static int32_t arg(T v) { return (int32_t)v; }
+    static int32_t arg(const char* s) { return (int32_t)(uintptr_t)s; }
+    static int32_t arg(const __FlashStringHelper* s) { return (int32_t)(uintptr_t)s; }
+
+    void put(uint8_t level, const char* fmt, uint8_t argc, const int32_t* args);
+    uint8_t format(char* line, uint8_t level, const char* fmt, uint8_t argc, const int32_t* args) const;
+};
+
+extern Logger logger;
+
+// Level filtering happens in the preprocessor below, the module mask folds at compile time
+#define LOG_AT(level, module, fmt, ...) do { \
+        if ((module) & LOG_MODULES) { \
+            static const char _logFmt[] PROGMEM = fmt; \
+            logger.log(level, _logFmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+// Disabled levels keep the arguments referenced in dead code, so they still type-check and
+// do not leave unused variables behind
+#define LOG_NONE(fmt, ...) do { if (0) logger.log(0, fmt, ##__VA_ARGS__); } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(module, fmt, ...) LOG_AT(LOG_LEVEL_ERROR, module, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(module, fmt, ...) LOG_NONE(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(module, fmt, ...) LOG_AT(LOG_LEVEL_WARN, module, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(module, fmt, ...) LOG_NONE(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(module, fmt, ...) LOG_AT(LOG_LEVEL_INFO, module, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(module, fmt, ...) LOG_NONE(fmt, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(module, fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, module, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(module, fmt, ...) LOG_NONE(fmt, ##__VA_ARGS__)
+#endif
+
+#endif // LOGGER_H
@@ -10,20 +10,31 @@ private:
 public:
     ManualMode(const char* name, int8_t dir) : DrillMode(name), direction(dir) {}
     
-    void loop(float knob) override {
+    void begin() override {
+        requestPwmProfile(IRF_PWM_SMOOTH);
+    }
+    
+    void tick(int16_t knob) override {
         if (!motor) return;
         
-        if (knob > 0.01f) {
-            motor->SetPower(knob * direction);
+        if (knob > irfDuty(0.01f)) {
+            driveSpeed(knob * direction);
             setState(STATE_RUNNING);
         } else {
             motor->HardStop();
+            if (speedControl) speedControl->reset();
             setState(STATE_IDLE);
         }
     }
     
+    // Slow decay: usable torque and a linear knob at creep speeds
+    uint8_t getDecay() const override {
+        return IRF_DECAY_SLOW;
+    }
+    
     void stop() override {
-        if (motor) motor->SetPower(0);
+        if (motor) motor->setDuty(0);
+        if (speedControl) speedControl->reset();
         setState(STATE_IDLE);
     }
 };
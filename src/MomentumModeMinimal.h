@@ -6,10 +6,14 @@
 class MomentumMode : public DrillMode {
 private:
     int8_t direction;
-    float currentSpeed;
-    float targetSpeed;
+    int16_t currentSpeed;  // Q1.15
+    int16_t targetSpeed;   // Q1.15
     uint32_t lastUpdate;
     
+    // Ramp rates in Q1.15 full scale per second
+    static const int32_t RATE_FAST = 2L * IRF_DUTY_MAX;   // 2.0 /s
+    static const int32_t RATE_SLOW = 3L * IRF_DUTY_MAX / 10; // 0.3 /s
+    
 public:
     MomentumMode(const char* name, int8_t dir) : 
         DrillMode(name), direction(dir),
@@ -20,32 +24,35 @@ public:
         targetSpeed = 0;
         lastUpdate = millis();
         setState(STATE_IDLE);
+        requestPwmProfile(IRF_PWM_SMOOTH);
     }
     
-    void loop(float knob) override {
+    void tick(int16_t knob) override {
         if (!motor) return;
         
         targetSpeed = knob * direction;
         uint32_t now = millis();
         
         if (now - lastUpdate > 10) {
-            float dt = (now - lastUpdate) / 1000.0f;
+            uint32_t dtMs = now - lastUpdate;
             lastUpdate = now;
-            float inc = 2.0F;
-            float dec = 0.3F;
+            int32_t inc = RATE_FAST;
+            int32_t dec = RATE_SLOW;
             if (direction == -1)
-                inc = 0.3F, dec = 2.0F;
+                inc = RATE_SLOW, dec = RATE_FAST;
+            int32_t speed = currentSpeed;
             if (targetSpeed > currentSpeed) {
-                currentSpeed += inc * dt;
-                if (currentSpeed > targetSpeed) currentSpeed = targetSpeed;
+                speed += inc * dtMs / 1000;
+                if (speed > targetSpeed) speed = targetSpeed;
             } else if (targetSpeed < currentSpeed) {
-                currentSpeed -= dec * dt;
-                if (currentSpeed < targetSpeed) currentSpeed = targetSpeed;
+                speed -= dec * dtMs / 1000;
+                if (speed < targetSpeed) speed = targetSpeed;
             }
+            currentSpeed = (int16_t)speed;
             
-            motor->SetPower(currentSpeed);
+            driveSpeed(currentSpeed);
             
-            if (fabs(currentSpeed) > 0.01f) {
+            if (abs(currentSpeed) > irfDuty(0.01f)) {
                 setState(STATE_RUNNING);
             } else {
                 setState(STATE_IDLE);
@@ -56,7 +63,8 @@ public:
     void stop() override {
         targetSpeed = 0;
         setState(STATE_IDLE);
-        if (motor) motor->SetPower(0);
+        if (motor) motor->setDuty(0);
+        if (speedControl) speedControl->reset();
     }
 };
 
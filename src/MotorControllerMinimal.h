@@ -2,6 +2,7 @@
 #define MOTOR_CONTROLLER_MINIMAL_H
 #define MaxPower 90
 #include <Arduino.h>
+#include "Logger.h"
 
 // TA6586 Motor Driver Controller
 // Replaces L298N - uses PWM on both control pins instead of separate enable pin
@@ -46,21 +47,19 @@ public:
             // Forward: in1 = PWM, in2 = 0
             analogWrite(in1, pwm);
             analogWrite(in2, 0);
-            Serial.print(F("FORWARD: "));
-            Serial.println(pwm);
+            LOG_DEBUG(LOG_MOTOR, "FORWARD: %u", pwm);
         } 
         else if (speed < -0.01f) {
             // Reverse: in1 = 0, in2 = PWM
             analogWrite(in1, 0);
             analogWrite(in2, pwm);
-            Serial.print(F("BACKWARD: "));
-            Serial.println(pwm);
+            LOG_DEBUG(LOG_MOTOR, "BACKWARD: %u", pwm);
         }
         else {
             // Stop: both = 0
             analogWrite(in1, 0);
             analogWrite(in2, 0);
-            Serial.println(F("Stop"));
+            LOG_DEBUG(LOG_MOTOR, "Stop");
         }
     }
     
@@ -0,0 +1,118 @@
+#include "Profiler.h"
+
+#if PROFILING
+#include <avr/interrupt.h>
+#include "IRFMotorDriver.h"
+
+Profiler profiler;
+
+#if IRF_PWM_BACKEND != IRF_PWM_TIMER1
+ISR(TIMER1_OVF_vect) {
+    profiler._overflow();
+}
+#endif
+
+static const char profName0[] PROGMEM = "pwm isr";
+static const char profName1[] PROGMEM = "adc isr";
+static const char profName2[] PROGMEM = "control";
+static const char profName3[] PROGMEM = "knob";
+static const char profName4[] PROGMEM = "display";
+static const char profName5[] PROGMEM = "loop";
+static const char* const profNames[PROF_SECTION_COUNT] PROGMEM = {
+    profName0, profName1, profName2, profName3, profName4, profName5
+};
+
+Profiler::Profiler() : _overflows(0) {
+    for (uint8_t i = 0; i < PROF_SECTION_COUNT; i++) clear(_sections[i]);
+}
+
+void Profiler::begin() {
+#if IRF_PWM_BACKEND != IRF_PWM_TIMER1
+    // Normal mode, no prescaler, overflow interrupt only
+    noInterrupts();
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1);
+    TIMSK1 = (1 << TOIE1);
+    _overflows = 0;
+    interrupts();
+#endif
+}
+
+uint32_t Profiler::now() const {
+#if IRF_PWM_BACKEND != IRF_PWM_TIMER1
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t t = TCNT1;
+    uint16_t hi = _overflows;
+    // Overflowed since interrupts went off but not counted yet
+    if ((TIFR1 & (1 << TOV1)) && t < 0x8000) hi++;
+    SREG = sreg;
+    return ((uint32_t)hi << 16) | t;
+#else
+    return micros() * (F_CPU / 1000000UL);
+#endif
+}
+
+void Profiler::record(uint8_t section, uint32_t cycles) {
+    ProfSection& s = _sections[section];
+    if (cycles < s.minCycles) s.minCycles = cycles;
+    if (cycles > s.maxCycles) s.maxCycles = cycles;
+    if (s.count != 0xFFFF) s.count++;
+
+    uint8_t b = 0;
+    uint32_t c = cycles >> 6;
+    while (c != 0 && b < PROF_BUCKETS - 1) {
+        c >>= 1;
+        b++;
+    }
+    if (s.buckets[b] != 0xFFFF) s.buckets[b]++;
+}
+
+void Profiler::report(Print& out) const {
+    const uint8_t cyclesPerUs = F_CPU / 1000000UL;
+    out.println(F("section count min max us, histogram from-us:count"));
+    for (uint8_t i = 0; i < PROF_SECTION_COUNT; i++) {
+        noInterrupts();
+        ProfSection s = _sections[i];
+        interrupts();
+
+        out.print((const __FlashStringHelper*)pgm_read_ptr(&profNames[i]));
+        out.print(' ');
+        out.print(s.count);
+        if (s.count == 0) {
+            out.println();
+            continue;
+        }
+        out.print(' ');
+        out.print(s.minCycles / cyclesPerUs);
+        out.print(' ');
+        out.print(s.maxCycles / cyclesPerUs);
+        for (uint8_t b = 0; b < PROF_BUCKETS; b++) {
+            if (s.buckets[b] == 0) continue;
+            out.print(' ');
+            out.print(b == 0 ? 0UL : 2UL << b);
+            out.print(':');
+            out.print(s.buckets[b]);
+        }
+        out.println();
+    }
+}
+
+void Profiler::reset() {
+    for (uint8_t i = 0; i < PROF_SECTION_COUNT; i++) {
+        noInterrupts();
+        clear(_sections[i]);
+        interrupts();
+    }
+}
+
+void Profiler::clear(ProfSection& s) {
+    s.minCycles = 0xFFFFFFFFUL;
+    s.maxCycles = 0;
+    s.count = 0;
+    for (uint8_t b = 0; b < PROF_BUCKETS; b++) s.buckets[b] = 0;
+}
+
+#endif // PROFILING
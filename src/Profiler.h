@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+// Section timing, enable with -DPROFILING=1 (see the nanoatmega328_profile env). With 0 the
+// PROFILE_SCOPE() macro is empty and nothing below is compiled in.
+#ifndef PROFILING
+#define PROFILING 0
+#endif
+
+// Timed sections, names in Profiler.cpp
+#define PROF_PWM_ISR  0  // IRFMotorDriver::_isr()
+#define PROF_ADC_ISR  1  // AnalogSampler::_isr()
+#define PROF_CONTROL  2  // Control tick: speed update and mode tick()
+#define PROF_KNOB     3  // readKnob()
+#define PROF_DISPLAY  4  // DisplayManager::loop(), one page
+#define PROF_LOOP     5  // One loop() iteration
+#define PROF_SECTION_COUNT 6
+
+// Log2 histogram: bucket 0 counts runs under 64 cycles (4us), bucket k runs of 2^(k+5) up to
+// 2^(k+6) cycles, the last bucket everything from 65536 cycles (4.1ms) up
+#define PROF_BUCKETS 12
+
+#if PROFILING
+
+struct ProfSection {
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint16_t count;                   // Saturates, as do the buckets
+    uint16_t buckets[PROF_BUCKETS];
+};
+
+/**
+ * Cycle-accurate timing of named code sections.
+ *
+ * Timer1 free-runs at the CPU clock, an overflow interrupt every 4ms extends it to 32 bits, so a
+ * timestamp is the cycle count since begin(). Each section keeps min, max and a log2 histogram.
+ * Every section is written from one context only (its ISR, the control tick or loop()), so
+ * record() needs no locking; report() copies each section with interrupts off.
+ *
+ * With the Timer1 PWM backend the timer is taken, timestamps then come from micros() and have a
+ * 64 cycle resolution.
+ */
+class Profiler {
+public:
+    Profiler();
+
+    // Start the cycle counter. Call before any section runs.
+    void begin();
+
+    // CPU cycles since begin(), wraps after ~268s. Safe from ISRs.
+    uint32_t now() const;
+
+    void record(uint8_t section, uint32_t cycles);
+
+    // Print min/max/count and the non-empty buckets of every section, in us
+    void report(Print& out) const;
+    void reset();
+
+    // Internal method called by ISR
+    void _overflow() { _overflows++; }
+
+private:
+    ProfSection _sections[PROF_SECTION_COUNT];
+    volatile uint16_t _overflows;
+
+    static void clear(ProfSection& s);
+};
+
+extern Profiler profiler;
+
+// Times the rest of the enclosing block
+class ProfileScope {
+public:
+    ProfileScope(uint8_t section) : _section(section), _start(profiler.now()) {}
+    ~ProfileScope() { profiler.record(_section, profiler.now() - _start); }
+
+private:
+    uint8_t _section;
+    uint32_t _start;
+};
+
+#define PROFILE_SCOPE(section) ProfileScope _profileScope(section)
+
+#else
+
+#define PROFILE_SCOPE(section)
+
+#endif // PROFILING
+
+#endif // PROFILER_H
@@ -0,0 +1,125 @@
+#ifndef SPEED_CONTROL_H
+#define SPEED_CONTROL_H
+
+#include <Arduino.h>
+#include "AnalogSampler.h"
+#include "IRFMotorDriver.h"
+
+// Back-EMF at full speed on the 12-bit terminal scale. With the 40V battery-style divider,
+// ~17V = 1739 codes. Speeds are Q1.15 fractions of this.
+#ifndef SPEED_BEMF_FULL_SCALE
+#define SPEED_BEMF_FULL_SCALE 1739
+#endif
+
+// Spindle speed at SPEED_BEMF_FULL_SCALE back-EMF (low gear), calibrates the turn counter
+#ifndef SPEED_FULL_RPM
+#define SPEED_FULL_RPM 450
+#endif
+// Back-EMF integral units (codes x 256us) per 1/256 turn
+#define SPEED_INTEGRAL_PER_TURN_Q8 (((uint32_t)SPEED_BEMF_FULL_SCALE * (60000000UL / SPEED_FULL_RPM)) >> 16)
+
+// PI gains in Q8 (256 = 1.0), applied once per back-EMF sample (~16ms)
+#ifndef SPEED_KP
+#define SPEED_KP 128
+#endif
+#ifndef SPEED_KI
+#define SPEED_KI 24
+#endif
+
+#define SPEED_FILTER_SHIFT 1     // IIR over 2 samples
+#define SPEED_TIMEOUT_MS   100   // No back-EMF sample for this long: estimate invalid, loop open
+
+/**
+ * Speed estimate from the back-EMF the AnalogSampler measures in the driver's coast windows, plus
+ * a PI loop on top of it.
+ *
+ * update() runs every control tick, before the mode: it consumes at most one new sample, filters
+ * it, and steps the PI with the target from the last regulate() call. regulate() is cheap and
+ * returns the target as a feed-forward duty plus the latest correction, so a mode can call it
+ * every tick.
+ * Without valid samples (Timer1 backend, no windows) regulate() passes the target through.
+ *
+ * The sampler ISR also integrates the back-EMF, which counts spindle revolutions independent of
+ * load and battery: take a mark with getAngle() and measure turnsSince(mark).
+ */
+class SpeedControl {
+private:
+    AnalogSampler* sampler;
+    uint8_t lastCount;
+    uint32_t lastSample;
+    bool valid;
+    int16_t speed;        // Q1.15, filtered
+    int16_t target;       // Q1.15, 0 = loop idle
+    int32_t integral;     // Q1.15
+    int16_t correction;   // P + I, Q1.15
+
+    static int16_t clamp(int32_t v, int16_t limit) {
+        return v > limit ? limit : (v < -limit ? -limit : (int16_t)v);
+    }
+
+public:
+    SpeedControl(AnalogSampler* s) :
+        sampler(s), lastCount(0), lastSample(0), valid(false),
+        speed(0), target(0), integral(0), correction(0) {}
+
+    // Returns true when a new sample was taken in
+    bool update() {
+        uint32_t now = millis();
+        uint8_t count = sampler->getBackEmfCount();
+        if (count == lastCount) {
+            if (now - lastSample > SPEED_TIMEOUT_MS) valid = false;
+            return false;
+        }
+        lastCount = count;
+        lastSample = now;
+
+        int32_t raw = (int32_t)sampler->readBackEmf() * IRF_DUTY_MAX / SPEED_BEMF_FULL_SCALE;
+        int32_t s = clamp(raw, IRF_DUTY_MAX);
+        if (!valid) {
+            speed = (int16_t)s;
+            valid = true;
+        } else {
+            speed = (int16_t)(speed + ((s - speed) >> SPEED_FILTER_SHIFT));
+        }
+
+        if (target != 0) {
+            int32_t error = (int32_t)target - speed;
+            integral += (error * SPEED_KI) >> 8;
+            integral = clamp(integral, IRF_DUTY_MAX / 2); // Anti-windup
+            correction = clamp(((error * SPEED_KP) >> 8) + integral, IRF_DUTY_MAX);
+        }
+        return true;
+    }
+
+    // Duty for a target speed, both Q1.15. Never drives against the target direction.
+    int16_t regulate(int16_t t) {
+        if (t == 0) {
+            reset();
+            return 0;
+        }
+        target = t;
+        if (!valid) return t;
+        int16_t duty = clamp((int32_t)t + correction, IRF_DUTY_MAX);
+        if ((t > 0 && duty < 0) || (t < 0 && duty > 0)) duty = 0;
+        return duty;
+    }
+
+    void reset() {
+        target = 0;
+        integral = 0;
+        correction = 0;
+    }
+
+    // Opaque angle mark for turnsSince()
+    int32_t getAngle() const { return sampler->readBackEmfIntegral(); }
+    
+    // Signed turns since a mark in Q8.8 (256 = one turn forward), saturating at +-127 turns
+    int16_t turnsSince(int32_t mark) const {
+        return clamp((getAngle() - mark) / (int32_t)SPEED_INTEGRAL_PER_TURN_Q8, INT16_MAX);
+    }
+
+    int16_t getSpeed() const { return speed; }
+    bool isValid() const { return valid; }
+};
+
+#endif
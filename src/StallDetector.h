@@ -0,0 +1,58 @@
+#ifndef STALL_DETECTOR_H
+#define STALL_DETECTOR_H
+
+#include <stdint.h>
+
+// Motor current above STALL_CURRENT_MA for STALL_TIME_MS is a stall. The slew limiter keeps
+// the start-up inrush well below the threshold for longer than that.
+#ifndef STALL_CURRENT_MA
+#define STALL_CURRENT_MA 25000
+#endif
+#ifndef STALL_TIME_MS
+#define STALL_TIME_MS 40
+#endif
+
+/**
+ * Over-current-for-time stall detector. Plain integer code without Arduino dependencies, so it can
+ * be fed recorded or simulated current traces on the host (tools/stall_sim.cpp).
+ *
+ * update() reports each stall once, on the sample that confirms it. The detector re-arms once the
+ * current drops below 3/4 of the threshold.
+ */
+class StallDetector {
+private:
+    uint16_t thresholdMa;
+    uint16_t timeMs;
+    uint32_t overSince;
+    bool over;
+    bool stalled;
+    uint8_t count;
+
+public:
+    StallDetector(uint16_t threshold = STALL_CURRENT_MA, uint16_t time = STALL_TIME_MS) :
+        thresholdMa(threshold), timeMs(time), overSince(0), over(false), stalled(false), count(0) {}
+
+    // Feed one current sample. Returns true when a new stall is detected.
+    bool update(uint16_t mA, uint32_t nowMs) {
+        if (mA >= thresholdMa) {
+            if (!over) {
+                over = true;
+                overSince = nowMs;
+            }
+            if (!stalled && nowMs - overSince >= timeMs) {
+                stalled = true;
+                count++;
+                return true;
+            }
+        } else if (mA < thresholdMa - thresholdMa / 4) {
+            over = false;
+            stalled = false;
+        }
+        return false;
+    }
+
+    bool isStalled() const { return stalled; }
+    uint8_t getCount() const { return count; }  // Stalls so far (wraps)
+};
+
+#endif
@@ -6,13 +6,29 @@
 // Maximum number of cycles we support (can be adjusted)
 #define MAX_CYCLES 5
 
+// Speeds are Q1.15 duty, write them as irfDuty(0.5f) so they fold at compile time.
+// Times include the driver's slew and reversal dwell: a step that reverses spends about
+// (|from| + |to|) x IRF_SLEW_MS plus IRF_REVERSE_DWELL_MS (rounded up to PWM periods) ramping,
+// ~37ms for 0.4 -> -0.9 with the defaults, so keep steps well above that.
 struct TapCycle {
-    float forwardSpeed;     // CW speed (0.0 to 1.0)
+    int16_t forwardSpeed;     // CW speed (0 to IRF_DUTY_MAX)
     unsigned long forwardTime;  // milliseconds
-    float backwardSpeed;    // CCW speed (-1.0 to 0.0)
+    int16_t backwardSpeed;    // CCW speed (-IRF_DUTY_MAX to 0)
     unsigned long backwardTime; // milliseconds
+    // Optional step length in spindle turns, write as tapTurns(2.5f). A step with turns set ends
+    // after that many turns and its time becomes the timeout. Needs a SpeedControl (back-EMF
+    // turn counter), without one the step runs on time only. 0 = time based.
+    uint16_t forwardTurns;
+    uint16_t backwardTurns;
 };
 
+// Turns to Q8.8 (256 = one turn)
+constexpr uint16_t tapTurns(float t) {
+    return t <= 0.0f ? 0 : (t >= 127.0f ? 0x7F00 : (uint16_t)(t * 256.0f + 0.5f));
+}
+
+// Configs live in flash: define the table PROGMEM, TapMode reads it with pgm_read_*().
+// The name strings stay in RAM, the display and the logger print them from there.
 struct TapConfig {
     const char* displayName;
     const char* material;
@@ -32,21 +48,23 @@ private:
     uint32_t totalSequenceTime;
     uint32_t sequenceStartTime;
     uint32_t completedTime;           // Time spent on completed steps
+    uint8_t stallCount;               // Stalls backed off from since begin()
+    int32_t stepAngle;                // Turn counter mark at the step start
     
 public:
     TapMode(const TapConfig* cfg) : 
-        DrillMode(cfg->displayName), config(cfg),
+        DrillMode((const char*)pgm_read_ptr(&cfg->displayName)), config(cfg),
         currentCycleIndex(0), currentStep(0), 
         sequenceActive(false), waitingForRelease(false),
         stepStartTime(0), totalSequenceTime(0), sequenceStartTime(0),
-        completedTime(0)
+        completedTime(0), stallCount(0), stepAngle(0)
     {
         // Calculate total sequence time
         if (config) {
             totalSequenceTime = 0;
-            for (uint8_t i = 0; i < config->numCycles; i++) {
-                totalSequenceTime += config->cycles[i].forwardTime;
-                totalSequenceTime += config->cycles[i].backwardTime;
+            for (uint8_t i = 0; i < getTotalCycles(); i++) {
+                totalSequenceTime += pgm_read_dword(&config->cycles[i].forwardTime);
+                totalSequenceTime += pgm_read_dword(&config->cycles[i].backwardTime);
             }
         }
     }
@@ -58,9 +76,11 @@ public:
         waitingForRelease = false;
         stepStartTime = 0;
         completedTime = 0;
+        stallCount = 0;
         setState(STATE_IDLE);
+        requestPwmProfile(IRF_PWM_TORQUE);
     }
-    void loop(float knob) override {
+    void tick(int16_t knob) override {
         if (!motor) return;
         
         // Start sequence only if:
@@ -104,6 +124,28 @@ public:
         waitingForRelease = false;
     }
     
+    // Tap binding on the forward step: skip the rest of it and back off right away
+    bool onStall() override {
+        if (!sequenceActive || currentStep != 0) return false;
+        
+        completedTime += getCurrentStepTime();
+        currentStep = 1;
+        stepStartTime = millis();
+        stallCount++;
+        applyCurrentStep();
+        return true;
+    }
+    
+    uint8_t getStallCount() const {
+        return stallCount;
+    }
+    
+    // Fast decay: at the ~61 Hz IRF_PWM_TORQUE period slow decay would cost ~10x the RMS current
+    // (see IRF_SLOW_DECAY_MAX_PERIOD_US), and the driver would not use it there anyway
+    uint8_t getDecay() const override {
+        return IRF_DECAY_FAST;
+    }
+    
     float getSequenceProgress() const override {
         if (!sequenceActive || totalSequenceTime == 0) return -1.0f;
         
@@ -130,7 +172,7 @@ public:
     
     // Get total cycles
     uint8_t getTotalCycles() const {
-        return config ? config->numCycles : 0;
+        return config ? pgm_read_byte(&config->numCycles) : 0;
     }
     
     // Get step within current cycle (1 = forward, 2 = backward)
@@ -155,6 +197,7 @@ private:
         applyCurrentStep();
     }
     
+    // Runs every control tick, so a step ends within a millisecond of its time
     void runSequence() {
         if (!config || !sequenceActive) return;
         
@@ -162,7 +205,7 @@ private:
         unsigned long stepDuration = getCurrentStepTime();
         
         // Check if current step is complete
-        if (currentTime - stepStartTime >= stepDuration) {
+        if (currentTime - stepStartTime >= stepDuration || stepTurnsDone()) {
             // Update completed time
             completedTime += stepDuration;
             
@@ -175,7 +218,7 @@ private:
                 currentCycleIndex++;
                 
                 // Check if all cycles are complete
-                if (currentCycleIndex >= config->numCycles) {
+                if (currentCycleIndex >= getTotalCycles()) {
                     sequenceComplete();
                     return;
                 }
@@ -188,29 +231,36 @@ private:
     }
     
     void applyCurrentStep() {
-        if (!motor || !config || currentCycleIndex >= config->numCycles) return;
-        
-        const TapCycle& cycle = config->cycles[currentCycleIndex];
+        if (!motor || !config || currentCycleIndex >= getTotalCycles()) return;
         
-        if (currentStep == 0) {
-            // Forward step
-            motor->SetPower(cycle.forwardSpeed);
-        } else {
-            // Backward step
-            motor->SetPower(cycle.backwardSpeed);
-        }
+        if (speedControl) stepAngle = speedControl->getAngle();
+        motor->setDuty(getCurrentStepSpeed());
     }
     
     unsigned long getCurrentStepTime() const {
-        if (!config || currentCycleIndex >= config->numCycles) return 0;
+        if (!config || currentCycleIndex >= getTotalCycles()) return 0;
         
-        const TapCycle& cycle = config->cycles[currentCycleIndex];
+        const TapCycle* cycle = &config->cycles[currentCycleIndex];
+        return pgm_read_dword(currentStep == 0 ? &cycle->forwardTime : &cycle->backwardTime);
+    }
+    
+    int16_t getCurrentStepSpeed() const {
+        const TapCycle* cycle = &config->cycles[currentCycleIndex];
+        return (int16_t)pgm_read_word(currentStep == 0 ? &cycle->forwardSpeed : &cycle->backwardSpeed);
+    }
+    
+    // Turn-based step reached its turns. Net turns in the step direction: the spindle still
+    // running the old way after a reversal is taken off, as it is from the thread.
+    bool stepTurnsDone() const {
+        if (!speedControl || !speedControl->isValid()) return false;
         
-        if (currentStep == 0) {
-            return cycle.forwardTime;
-        } else {
-            return cycle.backwardTime;
-        }
+        const TapCycle* cycle = &config->cycles[currentCycleIndex];
+        uint16_t turns = pgm_read_word(currentStep == 0 ? &cycle->forwardTurns : &cycle->backwardTurns);
+        if (turns == 0) return false;
+        
+        int16_t done = speedControl->turnsSince(stepAngle);
+        if (getCurrentStepSpeed() < 0) done = -done;
+        return done > 0 && (uint16_t)done >= turns;
     }
     
     void sequenceComplete() {
@@ -0,0 +1,121 @@
+#include "TaskScheduler.h"
+#include "Logger.h"
+#include <avr/wdt.h>
+
+static_assert(SCHED_STUCK_TICKS < 255, "SCHED_STUCK_TICKS must fit the uint8_t tick count");
+
+TaskScheduler::TaskScheduler() : _count(0), _current(255), _fed(false), _stuckTicks(255) {
+}
+
+bool TaskScheduler::add(const __FlashStringHelper* name, void (*run)(), uint16_t periodMs, uint8_t priority) {
+    if (_count >= SCHED_MAX_TASKS) return false;
+    SchedTask& t = _tasks[_count++];
+    t.name = name;
+    t.run = run;
+    t.periodMs = periodMs == 0 ? 1 : periodMs;
+    t.priority = priority;
+    t.due = 0;
+    t.lastUs = 0;
+    t.wcetUs = 0;
+    t.misses = 0;
+    t.runs = 0;
+    return true;
+}
+
+void TaskScheduler::begin() {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < _count; i++) {
+        _tasks[i].due = now;
+    }
+    wdt_enable(SCHED_WDT_TIMEOUT);
+    feedWatchdog();
+    _stuckTicks = 0;
+}
+
+bool TaskScheduler::run() {
+    uint32_t now = millis();
+    uint8_t pick = 255;
+    for (uint8_t i = 0; i < _count; i++) {
+        const SchedTask& t = _tasks[i];
+        if ((int32_t)(now - t.due) < 0) continue;
+        if (pick == 255 || t.priority < _tasks[pick].priority ||
+            (t.priority == _tasks[pick].priority && (int32_t)(t.due - _tasks[pick].due) < 0)) {
+            pick = i;
+        }
+    }
+    if (pick == 255) {
+        feedWatchdog();
+        return false;
+    }
+
+    SchedTask& t = _tasks[pick];
+    _current = pick;
+    uint32_t start = micros();
+    t.run();
+    uint32_t us = micros() - start;
+    _current = 255;
+    feedWatchdog();
+
+    t.lastUs = us > 65535 ? 65535 : us;
+    if (t.lastUs > t.wcetUs) t.wcetUs = t.lastUs;
+    t.runs++;
+
+    // Deadline = next release. Fixed rate, but never more than one release behind.
+    uint32_t finish = millis();
+    t.due += t.periodMs;
+    if ((int32_t)(finish - t.due) >= 0) {
+        t.misses++;
+        if ((int32_t)(finish - t.due) >= (int32_t)t.periodMs) t.due = finish;
+    }
+
+    if (us > SCHED_OVERRUN_US) {
+        LOG_WARN(LOG_MAIN, "Overrun: %S %uus", t.name, us);
+    }
+    return true;
+}
+
+void TaskScheduler::report(Print& out) const {
+    out.println(F("task period prio runs last wcet miss"));
+    for (uint8_t i = 0; i < _count; i++) {
+        const SchedTask& t = _tasks[i];
+        out.print(t.name);
+        out.print(' ');
+        out.print(t.periodMs);
+        out.print(F("ms "));
+        out.print(t.priority);
+        out.print(' ');
+        out.print(t.runs);
+        out.print(' ');
+        out.print(t.lastUs);
+        out.print(F("us "));
+        out.print(t.wcetUs);
+        out.print(F("us "));
+        out.println(t.misses);
+    }
+}
+
+void TaskScheduler::resetStats() {
+    for (uint8_t i = 0; i < _count; i++) {
+        _tasks[i].wcetUs = 0;
+        _tasks[i].misses = 0;
+        _tasks[i].runs = 0;
+    }
+}
+
+void TaskScheduler::feedWatchdog() {
+    wdt_reset();
+    _fed = true;
+}
+
+// Runs in the control tick, which preempts loop(): _current and _fed are single bytes and
+// _stuckTicks is only touched here after begin()
+bool TaskScheduler::checkStuck() {
+    if (_stuckTicks == 255) return false;
+    if (_fed) {
+        _fed = false;
+        _stuckTicks = 0;
+        return false;
+    }
+    if (_stuckTicks < SCHED_STUCK_TICKS) _stuckTicks++;
+    return _stuckTicks >= SCHED_STUCK_TICKS;
+}
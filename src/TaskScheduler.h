@@ -0,0 +1,85 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <Arduino.h>
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 6  // main.cpp registers six, 19 bytes of RAM each
+#endif
+
+// A single run longer than this is reported as an overrun when the task returns
+#ifndef SCHED_OVERRUN_US
+#define SCHED_OVERRUN_US 20000
+#endif
+
+// Reset-only watchdog, as before the scheduler: SCHED_WDT_TIMEOUT without a completed task resets
+// the MCU, whatever it is stuck in, interrupts disabled included
+#define SCHED_WDT_TIMEOUT WDTO_250MS
+
+// loop() without a completed task for this many control ticks (~1ms each) is stuck, checkStuck()
+// reports it ahead of the watchdog reset
+#ifndef SCHED_STUCK_TICKS
+#define SCHED_STUCK_TICKS 120
+#endif
+
+struct SchedTask {
+    const __FlashStringHelper* name;
+    void (*run)();
+    uint16_t periodMs;
+    uint8_t priority;      // Lower runs first when several tasks are due
+    uint32_t due;          // millis() of the next release
+    uint16_t lastUs;       // Execution time of the last run
+    uint16_t wcetUs;       // Longest run since resetStats(), saturates at 65535
+    uint16_t misses;       // Runs that finished after the next release was already due
+    uint16_t runs;
+};
+
+/**
+ * Cooperative fixed-rate scheduler for loop().
+ *
+ * Every task has a period and a priority. run() starts at most one task per call, the highest
+ * priority one among those that are due, so a long low-priority job delays the control tasks by
+ * at most its own run. Releases are fixed-rate (due += period), a task that fell more than a
+ * period behind skips the missed releases instead of bursting.
+ *
+ * The scheduler owns the watchdog: it is fed after every completed task. The watchdog cannot
+ * tell which task hung, the control tick can: it keeps running while loop() is stuck and calls
+ * checkStuck(), main.cpp keeps the answer in the flight recorder over the reset.
+ */
+class TaskScheduler {
+public:
+    TaskScheduler();
+
+    // Register a task before begin(). Returns false when the table is full.
+    bool add(const __FlashStringHelper* name, void (*run)(), uint16_t periodMs, uint8_t priority);
+
+    // Release all tasks now and start the watchdog
+    void begin();
+
+    // Run the most urgent due task, if any. Call from loop(). Returns false when nothing was due,
+    // the rest of that pass is idle time.
+    bool run();
+
+    // Print the task table: period, priority, runs, last and worst execution time, misses
+    void report(Print& out) const;
+    void resetStats();
+
+    uint8_t getTaskCount() const { return _count; }
+    const SchedTask& getTask(uint8_t i) const { return _tasks[i]; }
+    uint8_t getCurrentTask() const { return _current; }  // 255 = between tasks
+
+    // Call from the control tick. True once loop() has completed no task for SCHED_STUCK_TICKS,
+    // getCurrentTask() is then the one it is stuck in.
+    bool checkStuck();
+
+private:
+    SchedTask _tasks[SCHED_MAX_TASKS];
+    uint8_t _count;
+    volatile uint8_t _current;
+    volatile bool _fed;     // Set by feedWatchdog(), taken by checkStuck()
+    uint8_t _stuckTicks;    // Control ticks since the last feed, 255 until begin()
+
+    void feedWatchdog();
+};
+
+#endif // TASK_SCHEDULER_H
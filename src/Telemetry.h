@@ -0,0 +1,121 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <util/crc16.h>
+
+// Ring between the control tick and loop(), power of two
+#ifndef TELEMETRY_RING_SIZE
+#define TELEMETRY_RING_SIZE 128
+#endif
+
+#define TELEMETRY_MAX_PAYLOAD 32
+
+/**
+ * Framed binary telemetry on Serial, decoded on the host by tools/telemetry_decode.py.
+ *
+ * send() appends a frame to a ring: payload, CRC16 (_crc_ccitt_update from 0xFFFF, little
+ * endian), COBS encoded, with a zero byte on both sides. Text printed on the same port has no
+ * zero bytes, so it ends up in a block of its own that fails the CRC and the decoder skips it.
+ * A frame that does not fit the ring is dropped whole, the producer never waits.
+ *
+ * pump() moves bytes from the ring into the HardwareSerial TX buffer (sent by its UDRE
+ * interrupt) only as far as there is room. One producer (the control tick) and one consumer
+ * (loop()), so the ring needs no lock.
+ */
+class Telemetry {
+private:
+    uint8_t ring[TELEMETRY_RING_SIZE];
+    volatile uint8_t head;     // Producer
+    volatile uint8_t tail;     // Consumer
+    volatile bool enabled;
+    uint16_t sent;
+    uint16_t dropped;
+
+    // COBS: code byte = distance to the next zero, so the output never contains one
+    static uint8_t cobsEncode(const uint8_t* in, uint8_t len, uint8_t* out) {
+        uint8_t codeAt = 0;
+        uint8_t code = 1;
+        uint8_t n = 1;
+        for (uint8_t i = 0; i < len; i++) {
+            if (in[i] == 0) {
+                out[codeAt] = code;
+                codeAt = n++;
+                code = 1;
+            } else {
+                out[n++] = in[i];
+                code++;
+            }
+        }
+        out[codeAt] = code;
+        return n;
+    }
+
+public:
+    Telemetry() : head(0), tail(0), enabled(false), sent(0), dropped(0) {}
+
+    void setEnabled(bool e) { enabled = e; }
+    bool isEnabled() const { return enabled; }
+
+    // Queue one frame of up to TELEMETRY_MAX_PAYLOAD bytes. Returns false if it was dropped.
+    bool send(const uint8_t* payload, uint8_t len) {
+        if (!enabled || len > TELEMETRY_MAX_PAYLOAD) return false;
+
+        uint8_t raw[TELEMETRY_MAX_PAYLOAD + 2];
+        uint16_t crc = 0xFFFF;
+        for (uint8_t i = 0; i < len; i++) {
+            raw[i] = payload[i];
+            crc = _crc_ccitt_update(crc, payload[i]);
+        }
+        raw[len] = crc & 0xFF;
+        raw[len + 1] = crc >> 8;
+
+        uint8_t frame[TELEMETRY_MAX_PAYLOAD + 5];
+        frame[0] = 0;
+        uint8_t n = 1 + cobsEncode(raw, len + 2, frame + 1);
+        frame[n++] = 0;
+
+        uint8_t h = head;
+        uint8_t room = (uint8_t)(tail - h - 1) & (TELEMETRY_RING_SIZE - 1);
+        if (room < n) {
+            dropped++;
+            return false;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            ring[h] = frame[i];
+            h = (h + 1) & (TELEMETRY_RING_SIZE - 1);
+        }
+        // ring is not volatile: keep the compiler from sinking its stores below the publish
+        asm volatile("" ::: "memory");
+        head = h;
+        sent++;
+        return true;
+    }
+
+    // Hand queued frames to the serial TX buffer without ever waiting for it. Call every loop().
+    // Only whole frames go out, so text printed between two pump() calls never splits one.
+    void pump(HardwareSerial& out) {
+        uint8_t t = tail;
+        uint8_t h = head;
+        asm volatile("" ::: "memory"); // Read ring only after head
+        int room = out.availableForWrite();
+        while (t != h) {
+            // Leading zero, then up to and including the closing one
+            uint8_t n = 1;
+            for (uint8_t i = (t + 1) & (TELEMETRY_RING_SIZE - 1); ring[i] != 0; i = (i + 1) & (TELEMETRY_RING_SIZE - 1)) n++;
+            if (n + 1 > room) break;
+            room -= n + 1;
+            for (uint8_t i = 0; i <= n; i++) {
+                out.write(ring[t]);
+                t = (t + 1) & (TELEMETRY_RING_SIZE - 1);
+            }
+        }
+        asm volatile("" ::: "memory"); // Done reading before the producer may reuse the bytes
+        tail = t;
+    }
+
+    uint16_t getSentCount() const { return sent; }
+    uint16_t getDropCount() const { return dropped; }
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "TwiQueue.h"
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+TwiQueue* _twiQueueInstance = nullptr;
+
+ISR(TWI_vect) {
+    if (_twiQueueInstance) {
+        _twiQueueInstance->_isr();
+    }
+}
+
+#define TWI_CONTINUE ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWI_START    ((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE))
+#define TWI_STOP     ((1 << TWINT) | (1 << TWSTO) | (1 << TWEN))
+
+static_assert(TWI_QUEUE_SIZE <= 256, "TwiQueue indexes the ring with uint8_t");
+static_assert((F_CPU / TWI_QUEUE_FREQ - 16) / 2 <= 255, "TWI_QUEUE_FREQ too low for prescaler 1");
+
+TwiQueue::TwiQueue() :
+    _head(0), _committed(0), _tail(0), _start(0), _length(0), _remaining(0), _busy(false), _errors(0)
+{
+}
+
+void TwiQueue::begin() {
+    _twiQueueInstance = this;
+
+    // Internal pull-ups on SDA/SCL, as Wire does; the module usually has its own
+    digitalWrite(SDA, HIGH);
+    digitalWrite(SCL, HIGH);
+
+    noInterrupts();
+    TWSR = 0; // Prescaler 1
+    TWBR = (F_CPU / TWI_QUEUE_FREQ - 16) / 2;
+    TWCR = (1 << TWEN) | (1 << TWIE);
+    interrupts();
+}
+
+void TwiQueue::beginTransmission(uint8_t address) {
+    _start = _tail;
+    _length = 0;
+    put(address & 0xFE);
+    put(0); // Length, filled in by endTransmission()
+}
+
+void TwiQueue::write(uint8_t b) {
+    put(b);
+    _length++;
+}
+
+void TwiQueue::endTransmission() {
+    _buf[next(_start)] = _length;
+
+    noInterrupts();
+    _committed = _tail;
+    bool idle = !_busy;
+    _busy = true;
+    interrupts();
+    if (!idle) return;
+
+    // The previous STOP is still going out (~3us). A device holding the bus keeps TWSTO set for
+    // good, so wait with interrupts on and give up after TWI_QUEUE_TIMEOUT_US.
+    uint32_t since = micros();
+    while (TWCR & (1 << TWSTO)) {
+        if (micros() - since > TWI_QUEUE_TIMEOUT_US) {
+            _start = _tail; // Nothing open, this transaction goes with the rest
+            recover();
+            return;
+        }
+    }
+    TWCR = TWI_START;
+}
+
+// NACKs and bus resets so far. The ISR increments it, read both bytes with interrupts masked.
+uint16_t TwiQueue::getErrorCount() const {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t errors = _errors;
+    SREG = sreg;
+    return errors;
+}
+
+// Append a byte, waiting only while the ring is full
+void TwiQueue::put(uint8_t b) {
+    if (next(_tail) == _head) {
+        uint8_t head = _head;
+        uint32_t since = micros();
+        while (next(_tail) == _head) {
+            if (_head != head) {
+                head = _head;
+                since = micros();
+            } else if (micros() - since > TWI_QUEUE_TIMEOUT_US) {
+                recover();
+                break;
+            }
+        }
+    }
+    _buf[_tail] = b;
+    _tail = next(_tail);
+}
+
+// Bus stuck (no device, SDA held low): reset the TWI and drop everything already committed,
+// keeping the open transaction
+void TwiQueue::recover() {
+    noInterrupts();
+    TWCR = 0;
+    _head = _start;
+    _committed = _start;
+    _remaining = 0;
+    _busy = false;
+    _errors++;
+    TWCR = (1 << TWEN) | (1 << TWIE);
+    interrupts();
+}
+
+// One TWI event. Transactions are [address][length][data...] in the ring.
+void TwiQueue::_isr() {
+    uint8_t head = _head;
+    switch (TW_STATUS) {
+    case TW_START:
+    case TW_REP_START:
+        TWDR = _buf[head];
+        head = next(head);
+        _remaining = _buf[head];
+        _head = next(head);
+        TWCR = TWI_CONTINUE;
+        return;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if (_remaining > 0) {
+            TWDR = _buf[head];
+            _head = next(head);
+            _remaining--;
+            TWCR = TWI_CONTINUE;
+            return;
+        }
+        break;
+
+    default: {
+        // NACK, arbitration lost or bus error: skip the rest of this transaction
+        uint16_t skip = head + _remaining;
+        _head = skip < TWI_QUEUE_SIZE ? skip : skip - TWI_QUEUE_SIZE;
+        _remaining = 0;
+        _errors++;
+        break;
+    }
+    }
+
+    // Transaction done: straight into the next one, or release the bus
+    if (_head != _committed) {
+        TWCR = TWI_START;
+    } else {
+        TWCR = TWI_STOP;
+        _busy = false;
+    }
+}
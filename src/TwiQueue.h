@@ -0,0 +1,72 @@
+#ifndef TWI_QUEUE_H
+#define TWI_QUEUE_H
+
+#include <Arduino.h>
+
+// SCL frequency. The SSD1306 is specified for 400kHz, most modules also run at 800kHz.
+#ifndef TWI_QUEUE_FREQ
+#define TWI_QUEUE_FREQ 400000UL
+#endif
+
+// Ring size. One slot stays empty, so this holds one display page (DISPLAY_PAGE_BYTES) and no
+// more: the display queues the next page once the previous one is out.
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE 177
+#endif
+
+// A producer waiting for room, or for the last STOP to go out, gives up on a bus that made no
+// progress for this long
+#define TWI_QUEUE_TIMEOUT_US 5000
+
+/**
+ * Interrupt-driven TWI master transmitter.
+ *
+ * beginTransmission()/write()/endTransmission() append a transaction to a ring buffer and return
+ * right away. The TWI interrupt sends committed transactions back to back with repeated STARTs
+ * and releases the bus when the ring runs empty. A NACK drops the rest of that transaction.
+ *
+ * Write only, replaces Wire: do not use both in one build (they share the TWI vector).
+ */
+class TwiQueue {
+public:
+    TwiQueue();
+
+    // Set the bus clock, enable the pull-ups and the interrupt
+    void begin();
+
+    // Transaction to an 8-bit address (7-bit address << 1, as U8g2 uses). Transactions must be
+    // shorter than the ring, write() only waits if the ring is full.
+    void beginTransmission(uint8_t address);
+    void write(uint8_t b);
+    void endTransmission();
+
+    // Free bytes in the ring, check before queueing a large burst to never wait
+    uint8_t space() const {
+        int16_t free = (int16_t)_head - _tail - 1;
+        return free < 0 ? free + TWI_QUEUE_SIZE : free;
+    }
+    bool isIdle() const { return !_busy; }
+    uint16_t getErrorCount() const;
+
+    // Internal method called by ISR
+    void _isr();
+
+private:
+    uint8_t _buf[TWI_QUEUE_SIZE];
+    volatile uint8_t _head;       // Next byte the ISR sends
+    volatile uint8_t _committed;  // End of the last complete transaction
+    uint8_t _tail;                // Producer position, past _committed while a transaction is open
+    uint8_t _start;               // Header of the open transaction: address, length
+    uint8_t _length;
+    uint8_t _remaining;           // Data bytes left in the transaction on the bus, ISR only
+    volatile bool _busy;
+    volatile uint16_t _errors;
+
+    static uint8_t next(uint8_t i) { return i + 1 < TWI_QUEUE_SIZE ? i + 1 : 0; }
+    void put(uint8_t b);
+    void recover();
+};
+
+extern TwiQueue* _twiQueueInstance;
+
+#endif // TWI_QUEUE_H
@@ -1,7 +1,15 @@
 #include <Arduino.h>
-#include <Wire.h>
-#include <avr/wdt.h>
 #include "IRFMotorDriver.h"
+#include "AnalogSampler.h"
+#include "KnobCurves.h"
+#include "SpeedControl.h"
+#include "StallDetector.h"
+#include "TaskScheduler.h"
+#include "ControlTick.h"
+#include "Profiler.h"
+#include "FlightRecorder.h"
+#include "Telemetry.h"
+#include "Logger.h"
 #include "DisplayManagerSmart.h"
 #include "ManualModeMinimal.h"
 #include "MomentumModeMinimal.h"
@@ -14,22 +22,70 @@
 #define PIN_BUTTON_PREV 3
 #define PIN_ANALOG_KNOB A0
 #define PIN_BATTERY_LEVEL A3
+#define PIN_MOTOR_SENSE_1 A1  // Motor terminal on the MA1/MB1 leg, 40V divider like the battery
+#define PIN_MOTOR_SENSE_2 A2  // Motor terminal on the MB2/MA2 leg
+#define PIN_MOTOR_CURRENT A6  // Low-side shunt amplifier, MOTOR_CURRENT_FULL_SCALE_MA at 5V
+
+// Motor current sensing and stall detection. Needs the shunt amplifier on PIN_MOTOR_CURRENT
+// (A6 floats otherwise), enable with -DMOTOR_CURRENT_SENSE=1.
+#ifndef MOTOR_CURRENT_SENSE
+#define MOTOR_CURRENT_SENSE 0
+#endif
+#define MOTOR_CURRENT_FULL_SCALE_MA 50000UL  // 5mOhm shunt, gain 20
+
+// Back-EMF speed feedback for the manual and momentum modes. Needs the two terminal dividers,
+// enable with -DSPEED_FEEDBACK=1.
+#ifndef SPEED_FEEDBACK
+#define SPEED_FEEDBACK 0
+#endif
+
+// Binary telemetry for tools/telemetry_decode.py, toggled with 'b' on the serial monitor.
+// One 20 byte frame every TELEMETRY_DIVIDER control ticks; 115200 baud carries ~570 frames/s,
+// for every tick (~1 kHz) build with -DSERIAL_BAUD=500000 and set the host to match.
+#ifndef TELEMETRY
+#define TELEMETRY 0
+#endif
+#ifndef TELEMETRY_DIVIDER
+#define TELEMETRY_DIVIDER 10
+#endif
+#ifndef SERIAL_BAUD
+#define SERIAL_BAUD 115200
+#endif
 
 // Objects
 DisplayManager display;
+TaskScheduler scheduler;
+ControlTick controlTick;
+FlightRecorder recorder;
+#if TELEMETRY
+Telemetry telemetry;
+#endif
+AnalogSampler analog;
+uint8_t knobChannel;
+uint8_t batteryChannel;
+SpeedControl speedControl(&analog);
+uint8_t currentChannel;
+StallDetector stallDetector;
 // In main.cpp, update your tapConfigs:
 // In main.cpp, define your tap configurations with different cycle counts:
+// The table is PROGMEM (~500 bytes), TapMode reads it from flash.
 
-const TapConfig tapConfigs[] = {
+// Time of a tapTurns() step: the tuned time, or with the turn counter a timeout
+#if SPEED_FEEDBACK
+#define TAP_MS(ms, timeoutMs) (timeoutMs)
+#else
+#define TAP_MS(ms, timeoutMs) (ms)
+#endif
+
+const TapConfig tapConfigs[] PROGMEM = {
     
     // Acrylic 2mm - 2 identical cycles
     {
-        "Tap Ac2", "Ac", 20, 3, 
+        "Tap Ac2", "Ac", 20, 2, 
         {
-            // Both cycles same
-            {0.2f, 1200, 1.0f, 1000},
-            {0.1f, 100, -0.1f, 200}, // the direction changer. Don't directly reverse at 100% power
-            {-1.0f, 2000, -0.2f, 30 /* we don't actually need this one. */},
+            // Reversing straight from 100% is fine, the driver ramps through zero (IRF_SLEW_MS, IRF_REVERSE_DWELL_MS)
+            {irfDuty(0.2f), 1200, irfDuty(1.0f), 1000},
+            {irfDuty(-1.0f), 2000, irfDuty(-0.2f), 30 /* we don't actually need this one. */},
         }
     },
     
@@ -37,10 +93,10 @@ const TapConfig tapConfigs[] = {
     {
         "Tap Ac4", "Ac", 40, 4,  // 4 cycles
         {
-            {0.3f, 500, -0.2f, 400},  // Gentle
-            {0.4f, 450, -0.3f, 350},  // Medium
-            {0.5f, 400, -0.4f, 300},  // Firm
-            {0.3f, 300, -0.9f, 150}   // Break through
+            {irfDuty(0.3f), 500, irfDuty(-0.2f), 400},  // Gentle
+            {irfDuty(0.4f), 450, irfDuty(-0.3f), 350},  // Medium
+            {irfDuty(0.5f), 400, irfDuty(-0.4f), 300},  // Firm
+            {irfDuty(0.3f), 300, irfDuty(-0.9f), 150}   // Break through
         }
     },
     
@@ -48,7 +104,7 @@ const TapConfig tapConfigs[] = {
     {
         "Tap PL2", "PL", 20, 1,  // 1 cycle
         {
-            {0.7f, 300, -0.6f, 250}
+            {irfDuty(0.7f), 300, irfDuty(-0.6f), 250}
             // Remaining cycles in array are unused but must exist
         }
     },
@@ -57,9 +113,9 @@ const TapConfig tapConfigs[] = {
     {
         "Tap PL4", "PL", 40, 3,  // 3 cycles
         {
-            {0.5f, 400, -0.4f, 350},
-            {0.6f, 350, -0.5f, 300},
-            {0.4f, 200, -0.8f, 150}
+            {irfDuty(0.5f), 400, irfDuty(-0.4f), 350},
+            {irfDuty(0.6f), 350, irfDuty(-0.5f), 300},
+            {irfDuty(0.4f), 200, irfDuty(-0.8f), 150}
         }
     },
     
@@ -67,20 +123,23 @@ const TapConfig tapConfigs[] = {
     {
         "Tap PL6", "PL", 60, 2,  // 2 cycles
         {
-            {0.3f, 600, -0.2f, 500},
-            {0.4f, 400, -0.9f, 200}
+            {irfDuty(0.3f), 600, irfDuty(-0.2f), 500},
+            {irfDuty(0.4f), 400, irfDuty(-0.9f), 200}
         }
     },
     // Aluminum 1.5mm - 3 cycles with different parameters
+    // One turn in, half a turn back to break the chip, counted where the duty is high enough for
+    // the back-EMF turn counter (tools/turn_sim.py). A counted step's time is then a timeout with
+    // margin, TAP_MS() keeps the tuned time for the time-based build (SPEED_FEEDBACK=0).
     {
         "Tap Al1.5", "Al", 15, 3,  // 3 cycles
         {
             // Cycle 1: Fast approach, medium retreat
-            {0.8f, 300, -0.7f, 250},
+            {irfDuty(0.8f), TAP_MS(300, 450), irfDuty(-0.7f), TAP_MS(250, 350), tapTurns(1.0f), tapTurns(0.5f)},
             // Cycle 2: Medium approach, slow retreat
-            {0.6f, 400, -0.4f, 350},
+            {irfDuty(0.6f), TAP_MS(400, 500), irfDuty(-0.4f), 350, tapTurns(1.0f), 0},
             // Cycle 3: Slow approach, fast retreat (break chip)
-            {0.4f, 500, -0.9f, 200}
+            {irfDuty(0.4f), 500, irfDuty(-0.9f), TAP_MS(200, 250), 0, tapTurns(0.5f)}
         }
     },
 };
@@ -110,26 +169,18 @@ DrillMode* modes[] = {
 const uint8_t MODE_COUNT = sizeof(modes) / sizeof(modes[0]);
 uint8_t currentMode = 0;
 
-// Knob reading function
-float readKnobFraction() {
-    float adc = (float)analogRead(PIN_ANALOG_KNOB) * 5.0f / 1023.0f;
-    
-    if (adc <= 1.50f) return 0.0f;
-    
-    const float levels[] = {1.50f, 1.60f, 1.80f, 2.10f, 2.70f, 3.60f, 4.50f, 5.00f};
-    
-    float fac = 0;
-    for (int i = 1; i < 7; i++) {
-        float transitionPoint = levels[i] - (levels[i] - levels[i-1]) * 0.2f;
-        if (adc < transitionPoint) {
-            fac = (float)i / 6.0f;
-            break;;
-        }
+// Knob reading: one flash table lookup on the background-sampled code (see KnobCurves.h).
+// KNOB_HYSTERESIS is in 12-bit codes; the held code only follows moves larger than that.
+#define KNOB_HYSTERESIS 24
+uint8_t knobCurve = KNOB_CURVE;
+
+int16_t readKnob() {
+    static uint16_t heldCode = 0;
+    uint16_t code = analog.read(knobChannel);
+    if (code > heldCode + KNOB_HYSTERESIS || code + KNOB_HYSTERESIS < heldCode) {
+        heldCode = code;
     }
-    // remap non linearly 0 => 0, 1 => 1 but 0.5 > 0.2
-    fac = powf(fac, 1.5f);
-    if (adc >= 4.50f) return 1.0f;
-    return fac;
+    return knobLookup(knobCurve, heldCode);
 }
 
 // Memory check (optional)
@@ -139,31 +190,69 @@ int getFreeRam() {
     return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
 }
 
-#define MA1 5
-#define MA2 6
-#define MB1 8
-#define MB2 7
+// Bridge pins come from IRFDirectPins.h (MA1=5, MA2=6, MB1=8, MB2=7 unless overridden)
+#define MA1 IRF_PIN_HIGH_A
+#define MA2 IRF_PIN_LOW_A
+#define MB1 IRF_PIN_LOW_B
+#define MB2 IRF_PIN_HIGH_B
 
 IRFMotorDriver irfMotor(MA1, MB2, MA2, MB1);
 
+// Drive settings the active mode asked for. The driver switches at the next PWM period boundary.
+void applyModeDrive() {
+    irfMotor.setDecay(modes[currentMode]->getDecay());
+    irfMotor.setPwmProfile(modes[currentMode]->getPwmProfile());
+}
+
 void _9540(int pin, int state){
     digitalWrite(pin, state);
 }
 void _540(int pin, int state){
     digitalWrite(pin, state); // invert for IRF540
 }
+
+// Control tick and scheduler tasks, defined after loop state below
+void controlStep();
+void taskSensors();
+void taskThermal();
+void taskSerial();
+void taskUi();
+void taskDisplay();
+void taskDebug();
+
 void setup() {
-    Serial.begin(115200);
+    Serial.begin(SERIAL_BAUD);
+#if PROFILING
+    profiler.begin();
+#endif
+    
+    // What the control tick saw up to a watchdog or brown-out reset
+    if (recorder.hasCrashLog()) {
+        recorder.dump(Serial);
+    }
+    uint8_t stuckTask = recorder.getStuckTask();
+    recorder.begin();
     irfMotor.begin();
+    
+    // Knob and battery are sampled in the background, phase locked to the motor PWM
+    knobChannel = analog.addChannel(PIN_ANALOG_KNOB);
+    batteryChannel = analog.addChannel(PIN_BATTERY_LEVEL);
+#if MOTOR_CURRENT_SENSE
+    currentChannel = analog.addChannel(PIN_MOTOR_CURRENT);
+#endif
+#if SPEED_FEEDBACK
+    analog.setBackEmfPins(PIN_MOTOR_SENSE_1, PIN_MOTOR_SENSE_2);
+    analog.setBackEmfRail(batteryChannel);
+    irfMotor.setCoastWindows(true);
+#endif
+    analog.begin();
+    irfMotor.setPeriodHook(AnalogSampler::pwmTrigger);
     delay(100);
     
     Serial.print(F("Free RAM: "));
     Serial.println(getFreeRam());
     
-    // Initialize I2C
-    Wire.begin();
-    
-    // Initialize display
+    // Initialize display (owns the I2C bus through its TwiQueue)
     if (!display.begin()) {
         Serial.println(F("Display failed"));
         while(1);
@@ -180,134 +269,317 @@ void setup() {
         modes[i]->setMotor(&irfMotor);
         modes[i]->begin();
     }
+#if SPEED_FEEDBACK
+    manualCW.setSpeedControl(&speedControl);
+    manualCCW.setSpeedControl(&speedControl);
+    momentumCW.setSpeedControl(&speedControl);
+    momentumCCW.setSpeedControl(&speedControl);
+    // Tap modes only count turns for tapTurns() steps
+    tap1.setSpeedControl(&speedControl);
+    tap2.setSpeedControl(&speedControl);
+    tap3.setSpeedControl(&speedControl);
+    tap4.setSpeedControl(&speedControl);
+    tap5.setSpeedControl(&speedControl);
+    tap6.setSpeedControl(&speedControl);
+#endif
+    applyModeDrive();
     
-    // Enable watchdog timer - 1 second timeout
-    wdt_enable(WDTO_250MS);
+    // The active mode runs on the timer-driven control tick, everything else in loop()
+    controlTick.begin(controlStep);
+    
+    // Periodic jobs, highest priority first. The scheduler also runs the watchdog (~250ms).
+    scheduler.add(F("sensors"), taskSensors, 10, 1);
+    scheduler.add(F("thermal"), taskThermal, IRF_THERMAL_TICK_MS, 2);
+    scheduler.add(F("serial"), taskSerial, 20, 3);
+    scheduler.add(F("ui"), taskUi, 40, 4);
+    scheduler.add(F("display"), taskDisplay, 2, 5);
+    scheduler.add(F("debug"), taskDebug, 2000, 6);
+    if (stuckTask != FLIGHT_NOT_STUCK) {
+        Serial.print(F("Watchdog: "));
+        if (stuckTask < scheduler.getTaskCount()) Serial.print(scheduler.getTask(stuckTask).name);
+        else Serial.print(F("scheduler"));
+        Serial.println(F(" stuck"));
+    }
+    scheduler.begin();
     
     Serial.print(F("Ready. Modes: "));
     Serial.println(MODE_COUNT);
 }
 
 int motorPower = 0;
-void loop() {
+int16_t knob = 0;  // Written under controlTick.lock()
+uint8_t batteryDv = 0;  // Filtered battery voltage in 0.1V, for the flight recorder
+uint16_t batteryMv = 0; // Written under controlTick.lock()
+float motorSpeed = 0;  // Shown on the display, measured when SPEED_FEEDBACK is valid
+uint32_t modeDisplayUntil = 0;
+
+#if TELEMETRY
+// Telemetry frame, little endian. Keep in step with FRAME in tools/telemetry_decode.py.
+void sendTelemetry() {
+    static uint8_t seq = 0;
+    DrillMode* mode = modes[currentMode];
+    float progress = mode->getSequenceProgress();
+    int16_t duty = irfMotor.getDuty();
+    int16_t speed = INT16_MIN; // No measurement
+#if SPEED_FEEDBACK
+    if (speedControl.isValid()) speed = speedControl.getSpeed();
+#endif
+    uint16_t tick = (uint16_t)controlTick.getCount();
+    
+    uint8_t f[15];
+    f[0] = 1;                          // Frame version
+    f[1] = seq++;
+    f[2] = tick & 0xFF;
+    f[3] = tick >> 8;
+    f[4] = currentMode;
+    f[5] = mode->getState() | (irfMotor.getBridgeState() << 1) | (irfMotor.IsHardStopped() ? 0x08 : 0);
+    f[6] = knob & 0xFF;
+    f[7] = knob >> 8;
+    f[8] = duty & 0xFF;
+    f[9] = duty >> 8;
+    f[10] = speed & 0xFF;
+    f[11] = speed >> 8;
+    f[12] = batteryMv & 0xFF;
+    f[13] = batteryMv >> 8;
+    f[14] = progress < 0 ? 255 : (uint8_t)(progress * 200.0f); // 0.5% steps
+    telemetry.send(f, sizeof(f));
+}
+#endif
+
+#if MOTOR_CURRENT_SENSE
+// Shunt channel in mA, a multiply and a shift so the control tick can afford it
+uint16_t readMotorCurrent() {
+    return (uint32_t)analog.read(currentChannel) *
+           (MOTOR_CURRENT_FULL_SCALE_MA * 65536UL / ANALOG_FULL_SCALE) >> 16;
+}
+#endif
+
+// Control tick (~1 kHz, interrupt context). currentMode, knob and the mode objects are only
+// changed from loop() under controlTick.lock().
+void controlStep() {
+    PROFILE_SCOPE(PROF_CONTROL);
+#if SPEED_FEEDBACK
+    speedControl.update();
+#endif
+    modes[currentMode]->tick(knob);
+#if MOTOR_CURRENT_SENSE
+    // Stall check next to the mode it backs off, no task or display page in between.
+    // tools/stall_sim.cpp runs this detector on a motor model.
+    uint16_t currentMa = readMotorCurrent();
+    if (stallDetector.update(currentMa, millis())) {
+        bool backedOff = modes[currentMode]->onStall();
+        LOG_WARN(LOG_SENSE, "Stall: %umA in %s%S", currentMa, modes[currentMode]->getName(),
+                 backedOff ? F(", backing off") : F(""));
+    }
+#endif
+    
+    uint8_t task = scheduler.getCurrentTask();
+    // Name the task loop() hangs in before the watchdog resets, the tick keeps running meanwhile
+    recorder.setStuckTask(scheduler.checkStuck() ? task : FLIGHT_NOT_STUCK);
+    uint8_t sample[FLIGHT_FIELDS];
+    sample[FLIGHT_MODE] = currentMode;
+    sample[FLIGHT_KNOB] = (uint8_t)(knob >> 7);
+    sample[FLIGHT_DUTY] = (uint8_t)(irfMotor.getDuty() >> 8);
+    sample[FLIGHT_BATTERY] = batteryDv;
+    sample[FLIGHT_STATE] = irfMotor.getBridgeState() | (irfMotor.IsHardStopped() ? 0x04 : 0) |
+                           ((task < 15 ? task : 15) << 4);
+    recorder.record(sample);
+    
+#if TELEMETRY
+    static uint8_t telemetryTicks = 0;
+    if (telemetry.isEnabled() && ++telemetryTicks >= TELEMETRY_DIVIDER) {
+        telemetryTicks = 0;
+        sendTelemetry();
+    }
+#endif
+}
+
+// Tasks, see setup() for their periods and priorities
+
+void taskSensors() {
+    int16_t k;
+    {
+        PROFILE_SCOPE(PROF_KNOB);
+        k = readKnob();
+    }
+    irfMotor.setSupplyVoltage((uint32_t)analog.read(batteryChannel) * 40000UL / ANALOG_FULL_SCALE);
+    uint16_t mv = irfMotor.getSupplyVoltage();
+    controlTick.lock();
+    knob = k;
+    batteryMv = mv;
+    controlTick.unlock();
+    batteryDv = mv / 100 > 255 ? 255 : mv / 100;
+#if MOTOR_CURRENT_SENSE
+    irfMotor.setMotorCurrent(readMotorCurrent()); // Thermal model, the stall check is in controlStep()
+#endif
+}
+
+void taskThermal() {
     irfMotor.loop();
+}
+
+void taskSerial() {
     if (Serial.available()) {
         char b = Serial.read();
         if (b == 'a'){
             motorPower += 10; if (motorPower > 100) motorPower = 100; // Cap at 100%
             irfMotor.setPower(motorPower);
-            Serial.print(F("motorLeft: "));
-            Serial.println(motorPower);
+            LOG_INFO(LOG_MAIN, "motorLeft: %d", motorPower);
         }
         else if (b == 'd'){
             motorPower -= 10; if (motorPower < -100) motorPower = -100; // Cap at -100%
             irfMotor.setPower(motorPower);
-            Serial.print(F("motorRight: "));
-            Serial.println(motorPower);
+            LOG_INFO(LOG_MAIN, "motorRight: %d", motorPower);
         }
         else if (b == 's'){
             motorPower = 0;
             irfMotor.eBreak();
-            Serial.println("E-break");
+            LOG_INFO(LOG_MAIN, "E-break");
+        }
+        else if (b == 'k'){
+            knobCurve = (knobCurve + 1) % KNOB_CURVE_COUNT;
+            LOG_INFO(LOG_MAIN, "Knob curve: %u", knobCurve);
         }
+        else if (b == 't'){
+            scheduler.report(Serial);
+            scheduler.resetStats();
+            Serial.print(F("tick "));
+            Serial.print(controlTick.getCount());
+            Serial.print(' ');
+            Serial.print(controlTick.getMaxUs());
+            Serial.print(F("us overruns "));
+            Serial.print(controlTick.getOverruns());
+            Serial.print(F(" pwm late "));
+            Serial.println(irfMotor.getLateEdges());
+            controlTick.resetStats();
+        }
+#if TELEMETRY
+        else if (b == 'b'){
+            // Binary stream on/off, text keeps coming in between the frames
+            telemetry.setEnabled(!telemetry.isEnabled());
+            controlTick.lock();
+            uint16_t sent = telemetry.getSentCount();
+            uint16_t dropped = telemetry.getDropCount();
+            controlTick.unlock();
+            LOG_INFO(LOG_MAIN, "Telemetry %S, %u sent %u dropped",
+                     telemetry.isEnabled() ? F("on") : F("off"), sent, dropped);
+        }
+#endif
+#if PROFILING
+        else if (b == 'p'){
+            profiler.report(Serial);
+            profiler.reset();
+        }
+#endif
         else {
             motorPower = 0;
-            Serial.println("motorIdle");
+            LOG_INFO(LOG_MAIN, "motorIdle");
             irfMotor.idle();
         }
     }
-    // Feed the watchdog timer
-    wdt_reset();
-    
-    static uint32_t modeDisplayUntil = 0;
+}
+
+void taskUi() {
     uint32_t now = millis();
-    
-    // Read knob
-    static float knob = 0;
-    static uint32_t lastKnobRead = 0;
-    if (now - lastKnobRead > 10) {
-        knob = readKnobFraction();
-        lastKnobRead = now;
-    }
 
+    // Button handling with edge detection
+    static bool lastNext = HIGH, lastPrev = HIGH;
+    bool nextPressed = (digitalRead(PIN_BUTTON_NEXT) == LOW);
+    bool prevPressed = (digitalRead(PIN_BUTTON_PREV) == LOW);
     
-    // Run current mode
-    modes[currentMode]->loop(knob);
-    
-    static uint32_t lastDisplay = 0;
-    if (now - lastDisplay > 40) {
-        lastDisplay = now;
-
-        // Button handling with edge detection
-        static bool lastNext = HIGH, lastPrev = HIGH;
-        bool nextPressed = (digitalRead(PIN_BUTTON_NEXT) == LOW);
-        bool prevPressed = (digitalRead(PIN_BUTTON_PREV) == LOW);
+    // Mode switching
+    if ((nextPressed && !lastNext) || (prevPressed && !lastPrev)) {
+        controlTick.lock();
+        modes[currentMode]->stop();
         
-        
-            
-        // Mode switching
-        if ((nextPressed && !lastNext) || (prevPressed && !lastPrev)) {
-            modes[currentMode]->stop();
-            
-            if (nextPressed && !lastNext) {
-                currentMode = (currentMode + 1) % MODE_COUNT;
-            }
-            if (prevPressed && !lastPrev) {
-                currentMode = (currentMode + MODE_COUNT - 1) % MODE_COUNT;
-            }
-            
-            // Show centered mode title
-            display.showModeTitle(modes[currentMode]->getName());
-            
-            // Set display timeout
-            modeDisplayUntil = now + 1000;
+        if (nextPressed && !lastNext) {
+            currentMode = (currentMode + 1) % MODE_COUNT;
+        }
+        if (prevPressed && !lastPrev) {
+            currentMode = (currentMode + MODE_COUNT - 1) % MODE_COUNT;
         }
-            
-        lastNext = nextPressed;
-        lastPrev = prevPressed;
+        applyModeDrive();
+        controlTick.unlock();
         
-        // Get display data
-        float motorSpeed = irfMotor.GetSpeed();
-        float sequenceProgress = modes[currentMode]->getSequenceProgress();
+        // Show centered mode title
+        display.showModeTitle(modes[currentMode]->getName());
         
-        float voltageOnMax = 19.5F;
-        float voltageOnMin = 14.0F;
-        float currentVoltage = analogRead(PIN_BATTERY_LEVEL) * (40.0f / 1023.0f);
-        int batteryLevel = (currentVoltage - voltageOnMin) / (voltageOnMax - voltageOnMin) * 100;
-        if (batteryLevel > 100) batteryLevel = 100;
-        if (batteryLevel < 0) batteryLevel = 0;
-        // Serial.print(F("Battery Voltage: "));
-        // Serial.println(currentVoltage);
-        // Update display
-        if (now < modeDisplayUntil) {
-            // Mode title display
-            if (nextPressed || prevPressed) {
-                // Refresh while holding
-                static uint32_t lastHoldRefresh = 0;
-                if (now - lastHoldRefresh > 300) {
-                    display.showModeTitle(modes[currentMode]->getName());
-                    lastHoldRefresh = now;
-                }
+        // Set display timeout
+        modeDisplayUntil = now + 1000;
+    }
+        
+    lastNext = nextPressed;
+    lastPrev = prevPressed;
+    
+    // Get display data
+    controlTick.lock();
+    motorSpeed = irfMotor.GetSpeed();
+#if SPEED_FEEDBACK
+    if (speedControl.isValid()) {
+        motorSpeed = speedControl.getSpeed() / (float)IRF_DUTY_MAX; // Measured, not commanded
+    }
+#endif
+    float sequenceProgress = modes[currentMode]->getSequenceProgress();
+    controlTick.unlock();
+    
+    float voltageOnMax = 19.5F;
+    float voltageOnMin = 14.0F;
+    float currentVoltage = irfMotor.getSupplyVoltage() / 1000.0f;
+    int batteryLevel = (currentVoltage - voltageOnMin) / (voltageOnMax - voltageOnMin) * 100;
+    if (batteryLevel > 100) batteryLevel = 100;
+    if (batteryLevel < 0) batteryLevel = 0;
+    // Update display
+    if (now < modeDisplayUntil) {
+        // Mode title display
+        if (nextPressed || prevPressed) {
+            // Refresh while holding
+            static uint32_t lastHoldRefresh = 0;
+            if (now - lastHoldRefresh > 300) {
+                display.showModeTitle(modes[currentMode]->getName());
+                lastHoldRefresh = now;
             }
-        } else {
-            // Normal display
-            display.updateModeInfo(
-                modes[currentMode]->getName(),  // const char* modeName
-                currentMode,                    // uint8_t modeIndex  
-                motorSpeed,                     // float motorSpeed
-                sequenceProgress,                // float sequenceProgress
-                batteryLevel                     // int batteryLevel (0-100)
-            );
-        }
-        // Optional: Debug output
-        static uint32_t lastDebug = 0;
-        if (now - lastDebug > 2000) {
-            Serial.print(F("Mode: "));
-            Serial.print(currentMode);
-            Serial.print(F(" Speed: "));
-            Serial.println(motorSpeed);
-            lastDebug = now;
         }
+    } else {
+        // Normal display
+        display.updateModeInfo(
+            modes[currentMode]->getName(),  // const char* modeName
+            currentMode,                    // uint8_t modeIndex  
+            motorSpeed,                     // float motorSpeed
+            sequenceProgress,                // float sequenceProgress
+            batteryLevel,                    // int batteryLevel (0-100)
+            irfMotor.getThermalLoad()        // int thermalLoad (%, derating from 75)
+        );
     }
-    
-}
\ No newline at end of file
+}
+
+// Send at most one display page, taskUi only updates the content
+void taskDisplay() {
+    PROFILE_SCOPE(PROF_DISPLAY);
+    display.loop();
+}
+
+void taskDebug() {
+#if TELEMETRY
+    if (telemetry.isEnabled()) {
+        // Mode and duty are in the stream, the thermal model is not
+        LOG_INFO(LOG_MAIN, "Motor: %dC FET: %dC Limit: %d%%",
+                 irfMotor.getMotorTemperature(), irfMotor.getFetTemperature(),
+                 (int32_t)irfMotor.getDutyLimit() * 100 / IRF_DUTY_MAX);
+        return;
+    }
+#endif
+    LOG_INFO(LOG_MAIN, "Mode: %u Speed: %d%% Motor: %dC FET: %dC Limit: %d%%",
+             currentMode, (int16_t)(motorSpeed * 100), irfMotor.getMotorTemperature(),
+             irfMotor.getFetTemperature(), (int32_t)irfMotor.getDutyLimit() * 100 / IRF_DUTY_MAX);
+}
+
+void loop() {
+    PROFILE_SCOPE(PROF_LOOP);
+    bool busy = scheduler.run();
+#if TELEMETRY
+    telemetry.pump(Serial);
+#endif
+    if (!busy) {
+        logger.drain(Serial); // Idle pass: format queued log lines
+    }
+}
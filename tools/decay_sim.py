@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Compare fast and slow decay (IRFMotorDriver::setDecay()) on a lumped DC-motor model.
+
+The software PWM drives the motor from the pack for the ON phase. The OFF phase
+either coasts, with the current dying out through the body diodes against the
+supply (IRF_DECAY_FAST), or shorts the winding through both high sides
+(IRF_DECAY_SLOW). The model is one electrical pole (R, L, back-EMF) and one
+mechanical pole (inertia, viscous and Coulomb friction), stepped with explicit
+Euler. It is meant for the shape of the curves, not for absolute numbers.
+
+    decay_sim.py                      # default duties at 245 Hz
+    decay_sim.py --pwm-hz 1950 0.05 0.1 0.2
+    decay_sim.py --pwm-hz 61 0.2 0.4 0.6 0.8   # IRF_PWM_TORQUE, why it runs fast decay
+
+Columns: steady-state speed, mean and RMS winding current, and the copper loss
+I_rms^2 R for each decay mode, plus the no-load ideal speed D*V/Ke.
+"""
+
+import argparse
+import math
+
+V = 18.0        # Pack voltage
+R = 0.4         # Winding resistance, ohm
+L = 150e-6      # Winding inductance, H
+KE = 0.012      # Back-EMF constant, V s/rad (= Kt in N m/A)
+J = 2e-5        # Rotor inertia, kg m^2
+B = 2e-6        # Viscous friction, N m s/rad
+TC = 0.02       # Coulomb friction plus light load, N m
+DIODE = 1.4     # Two body diodes in the fast-decay path, V
+
+DT = 2e-6       # Integration step, s
+SETTLE = 0.8    # Averaging starts after this, s
+END = 1.2
+
+
+def run(duty, slow, pwm_hz):
+    period = 1.0 / pwm_hz
+    i = w = t = 0.0
+    n = 0
+    w_sum = i_sum = i2_sum = 0.0
+    for _ in range(int(END / DT)):
+        on = (t % period) / period < duty
+        emf = KE * w
+        if on:
+            v = V
+        elif slow:
+            v = 0.0
+        elif i > 0:
+            v = -V - DIODE
+        else:
+            v = None  # Bridge off and no current: the terminals float
+
+        if v is None:
+            i = 0.0
+        else:
+            i += (v - R * i - emf) / L * DT
+            if not on and not slow and i < 0:
+                i = 0.0  # The diodes do not conduct backwards
+
+        torque = KE * i - B * w
+        if w > 0 or torque > TC:
+            torque -= TC
+        elif torque > 0:
+            torque = 0.0
+        w = max(0.0, w + torque / J * DT)
+        t += DT
+
+        if t > SETTLE:
+            w_sum += w
+            i_sum += i
+            i2_sum += i * i
+            n += 1
+    rms = math.sqrt(i2_sum / n)
+    return w_sum / n * 60 / (2 * math.pi), i_sum / n, rms, rms * rms * R
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("duty", type=float, nargs="*", default=[0.05, 0.1, 0.2, 0.3, 0.5, 0.7, 1.0])
+    ap.add_argument("--pwm-hz", type=float, default=245.0)
+    args = ap.parse_args()
+
+    print("duty | fast: rpm   I_avg  I_rms  loss | slow: rpm   I_avg  I_rms  loss | ideal rpm")
+    for d in args.duty:
+        fast = run(d, False, args.pwm_hz)
+        slow = run(d, True, args.pwm_hz)
+        ideal = d * V / KE * 60 / (2 * math.pi)
+        print("%.2f |  %8.0f %6.2f %6.2f %5.1f |  %8.0f %6.2f %6.2f %5.1f | %8.0f"
+              % ((d,) + fast + slow + (ideal,)))
+
+
+if __name__ == "__main__":
+    main()
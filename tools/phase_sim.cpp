@@ -0,0 +1,88 @@
+// Host check of the late-edge recovery in the Timer2 software PWM (src/IRFPhase.h).
+//
+//     g++ -O2 -I src tools/phase_sim.cpp -o phase_sim && ./phase_sim
+//
+// Timer2 runs in CTC mode: every timer clock the counter is compared with OCR2A, a match sets the
+// flag and clears the counter, otherwise it counts up and rolls over at 255. A write to TCNT2
+// blocks the compare on the next timer clock (ATmega328P datasheet, "Compare Match Blocking by
+// TCNT2 Write"), which in CTC also skips the clear.
+//
+// For every phase length and every counter value the ISR can find past the new top, this stores
+// OCR2A, applies the recovery like setPhaseTicks() does and counts the timer clocks to the edge.
+// Without the recovery a late edge costs a whole lap. Restarting a one-tick phase at TCNT2 = 0
+// is shown as well: the blocked match lets the counter run on and it laps too. Exits with 1 if
+// any late edge takes more than two clocks.
+
+#include <cstdio>
+#include "IRFPhase.h"
+
+struct Timer2 {
+    uint8_t tcnt;
+    uint8_t ocr;
+    bool blocked;
+
+    // One timer clock, true on a compare match
+    bool clock() {
+        bool match = tcnt == ocr && !blocked;
+        blocked = false;
+        tcnt = match ? 0 : (uint8_t)(tcnt + 1);
+        return match;
+    }
+
+    void write(uint8_t v) {
+        tcnt = v;
+        blocked = true;
+    }
+};
+
+enum Recovery { NONE, LATE_COUNT, RESTART_AT_ZERO };
+
+// Timer clocks from the OCR2A store to the next match
+static int clocksToEdge(uint8_t ticks, uint8_t tcnt, Recovery how) {
+    Timer2 t = { tcnt, 0, false };
+    uint8_t top = ticks - 1;
+    t.ocr = top;
+    if (t.tcnt > top) {
+        if (how == LATE_COUNT) t.write(irfLateCount(top));
+        else if (how == RESTART_AT_ZERO) t.write(0);
+    }
+    for (int n = 1; n <= 600; n++) {
+        if (t.clock()) return n;
+    }
+    return -1;
+}
+
+int main() {
+    static const char* names[] = { "none", "irfLateCount()", "TCNT2 = 0" };
+    int failed = 0;
+
+    printf("recovery        | phase ticks | late TCNT2 | clocks to edge\n");
+    for (int how = NONE; how <= RESTART_AT_ZERO; how++) {
+        int ranges[][2] = { { 1, 1 }, { 2, 2 }, { 3, 255 } };
+        for (auto& r : ranges) {
+            int worst = 0, best = 1000;
+            for (int ticks = r[0]; ticks <= r[1]; ticks++) {
+                for (int tcnt = ticks; tcnt <= 255; tcnt++) {
+                    int n = clocksToEdge(ticks, tcnt, (Recovery)how);
+                    if (n < 0) n = 1000;
+                    if (n > worst) worst = n;
+                    if (n < best) best = n;
+                }
+            }
+            printf("%-15s | %4d..%-5d | %3d..255   | %d..%d\n",
+                   names[how], r[0], r[1], r[0], best, worst);
+            if (how == LATE_COUNT && worst > 2) failed = 1;
+        }
+    }
+
+    // On time: the phase must last exactly its ticks from a counter that was just cleared
+    for (int ticks = 1; ticks <= 255; ticks++) {
+        if (clocksToEdge(ticks, 0, LATE_COUNT) != ticks) {
+            printf("on-time phase of %d ticks is wrong\n", ticks);
+            failed = 1;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "late edges within 2 clocks, on-time phases exact\n");
+    return failed;
+}
@@ -0,0 +1,135 @@
+// Host check of the stall detector (src/StallDetector.h) on a DC-motor model.
+//
+//     g++ -O2 -I src tools/stall_sim.cpp -o stall_sim && ./stall_sim
+//     ./stall_sim 10 30      # fed from a 10 ms task that can run up to 30 ms late
+//
+// The motor is the lumped model of tools/decay_sim.py behind a 45:1 gearbox, on the IRF_PWM_TORQUE
+// software PWM (~61 Hz) in fast decay, with the driver's slew limit. The shunt channel is sampled
+// like the AnalogSampler does: every PWM period start triggers two rounds over knob, battery and
+// current, 104 us per conversion, and four current samples make one published value. That value is
+// the low-side current a few hundred us into the ON phase, not the average.
+//
+// The detector is fed from the control tick (every 1 ms) by default, or with the arguments from a
+// task every <period> ms that runs up to <jitter> ms late. Each scenario prints when the spindle
+// locked and when the detector fired.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "StallDetector.h"
+
+static const double V = 18.0, R = 0.4, L = 150e-6, KE = 0.012;
+static const double J = 2e-5, B = 2e-6, TC = 0.02, DIODE = 0.7;
+static const double GEAR = 45;
+static const int DT_US = 2;
+
+static const int PERIOD_US = 255 * 64;  // IRF_PWM_TORQUE
+static const int SLEW_MS = 20;          // IRF_SLEW_MS
+static const int CONV_US = 104;
+static const int CURRENT_SLOT = 2;      // knob, battery, current
+static const int CHANNELS = 3;
+static const double FULL_SCALE_MA = 50000; // MOTOR_CURRENT_FULL_SCALE_MA
+
+struct Scenario {
+    const char* name;
+    double duty;
+    double loadNm;      // Spindle load while cutting
+    double lockAt;      // Spindle jams at this time, s, 0 = never
+};
+
+static const Scenario scenarios[] = {
+    { "start, no load",   0.8, 0.0, 0 },
+    { "start, tapping",   0.8, 6.0, 0 },
+    { "heavy cut",        0.9, 12.0, 0 },
+    { "tap binds",        0.8, 6.0, 0.6 },
+    { "tap binds, 0.4",   0.4, 3.0, 0.6 },
+};
+
+static void run(const Scenario& s, int feedMs, int jitterMs) {
+    StallDetector detector;
+    double i = 0, w = 0;
+    double duty = 0;
+    double slewPerPeriod = PERIOD_US / (SLEW_MS * 1000.0);
+    int onUs = 0;
+    uint16_t sum = 0, published = 0;
+    int samples = 0;
+    int nextFeed = feedMs;
+    double peakMa = 0;
+    double lockedAt = -1, firedAt = -1;
+
+    const double DT = DT_US * 1e-6;
+    for (long us = 0; us < 1500000; us += DT_US) {
+        double t = us * 1e-6;
+        int pos = us % PERIOD_US;
+        if (pos == 0) {
+            duty = duty + slewPerPeriod < s.duty ? duty + slewPerPeriod : s.duty;
+            onUs = (int)(duty * 255 + 0.5) * 64;
+        }
+        bool on = pos < onUs;
+
+        // ADC: current conversions of the two rounds after each period start
+        for (int round = 0; round < 2; round++) {
+            int at = (round * CHANNELS + CURRENT_SLOT) * CONV_US + 12;
+            if (pos == at) {
+                double ma = i > 0 ? i * 1000 : 0;  // The shunt only sees the ON-phase current
+                int code = (int)(ma / FULL_SCALE_MA * 1023);
+                sum += code > 1023 ? 1023 : code;
+                if (++samples == 4) {
+                    published = sum;  // 12-bit scale
+                    sum = 0;
+                    samples = 0;
+                }
+            }
+        }
+
+        double emf = KE * w;
+        if (on) {
+            i += (V - R * i - emf) / L * DT;
+        } else if (i > 0) {
+            i += (-V - 2 * DIODE - R * i - emf) / L * DT;
+            if (i < 0) i = 0;
+        }
+
+        bool locked = s.lockAt > 0 && t >= s.lockAt;
+        if (locked) {
+            if (lockedAt < 0) lockedAt = t;
+            w = 0;
+        } else {
+            double load = TC + s.loadNm / GEAR;
+            double torque = KE * i - B * w;
+            if (w > 0 || torque > load) torque -= load;
+            else if (torque > 0) torque = 0;
+            w += torque / J * DT;
+            if (w < 0) w = 0;
+        }
+
+        // Detector feed, on whole milliseconds
+        if (us % 1000 == 0) {
+            uint32_t ms = us / 1000;
+            if (ms >= (uint32_t)nextFeed) {
+                uint16_t ma = (uint32_t)published * (uint32_t)FULL_SCALE_MA / 4092;
+                if (ma > peakMa && (s.lockAt == 0 || t < s.lockAt)) peakMa = ma;
+                if (detector.update(ma, ms) && firedAt < 0) firedAt = ms / 1000.0;
+                nextFeed = ms + feedMs + (jitterMs ? rand() % (jitterMs + 1) : 0);
+            }
+        }
+    }
+
+    printf("%-16s | %8.0f | ", s.name, peakMa);
+    if (lockedAt >= 0) printf("locked %4.0f ms | ", lockedAt * 1000);
+    else printf("               | ");
+    if (firedAt < 0) printf("no stall\n");
+    else if (lockedAt < 0 || firedAt < lockedAt) printf("FALSE stall at %.0f ms\n", firedAt * 1000);
+    else printf("stall +%.0f ms\n", (firedAt - lockedAt) * 1000);
+}
+
+int main(int argc, char** argv) {
+    int feedMs = argc > 1 ? atoi(argv[1]) : 1;
+    int jitterMs = argc > 2 ? atoi(argv[2]) : 0;
+    srand(1);
+    printf("STALL_CURRENT_MA %d, STALL_TIME_MS %d, fed every %d ms (+0..%d)\n",
+           STALL_CURRENT_MA, STALL_TIME_MS, feedMs, jitterMs);
+    printf("scenario         | peak mA  | spindle        | detector\n");
+    for (const Scenario& s : scenarios) run(s, feedMs, jitterMs);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Decode the firmware's binary telemetry (src/Telemetry.h) into CSV.
+
+Frames are COBS encoded between two zero bytes. The payload is followed by a
+CRC16 (avr-libc _crc_ccitt_update, start 0xFFFF, little endian). Anything that
+does not decode, like the text the firmware prints on the same port, is skipped.
+
+    telemetry_decode.py /dev/ttyUSB0 -b 115200 -o run.csv   # live, Ctrl+C to stop
+    telemetry_decode.py capture.bin -o run.csv              # raw capture file
+
+Send 'b' on the serial monitor (or pass --start) to switch the stream on.
+Reading a serial port needs pyserial.
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+# Frame version 1, see sendTelemetry() in src/main.cpp
+FRAME = struct.Struct("<BBHBBhhhHB")
+FIELDS = ["tick", "ms", "seq", "mode", "running", "bridge", "ebreak",
+          "knob", "duty", "speed", "battery_v", "progress"]
+TICK_MS = 1.024  # Control tick period (Timer0, 16MHz / 64 / 256)
+
+
+def crc_ccitt_update(crc, data):
+    data ^= crc & 0xFF
+    data ^= (data << 4) & 0xFF
+    return (((data << 8) | (crc >> 8)) ^ (data >> 4) ^ (data << 3)) & 0xFFFF
+
+
+def cobs_decode(block):
+    out = bytearray()
+    i = 0
+    while i < len(block):
+        code = block[i]
+        if code == 0 or i + code > len(block):
+            return None
+        out += block[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(block):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.tick = None      # Unwrapped tick count
+        self.seq = None
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+
+    def feed(self, data):
+        """Yield one row per good frame in data."""
+        self.buf += data
+        while True:
+            end = self.buf.find(0)
+            if end < 0:
+                return
+            block = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if block:
+                row = self.frame(block)
+                if row is not None:
+                    yield row
+
+    def frame(self, block):
+        raw = cobs_decode(block)
+        if raw is None or len(raw) != FRAME.size + 2:
+            self.bad += 1
+            return None
+        crc = 0xFFFF
+        for b in raw[:-2]:
+            crc = crc_ccitt_update(crc, b)
+        if crc != raw[-2] | (raw[-1] << 8):
+            self.bad += 1
+            return None
+
+        (version, seq, tick, mode, flags, knob, duty, speed,
+         battery, progress) = FRAME.unpack(raw[:-2])
+        if version != 1:
+            self.bad += 1
+            return None
+
+        if self.seq is not None:
+            self.lost += (seq - self.seq - 1) & 0xFF
+        self.seq = seq
+        if self.tick is None:
+            self.tick = tick
+        else:
+            self.tick += (tick - self.tick) & 0xFFFF
+        self.frames += 1
+
+        return {
+            "tick": self.tick,
+            "ms": round(self.tick * TICK_MS, 1),
+            "seq": seq,
+            "mode": mode,
+            "running": flags & 1,
+            "bridge": (flags >> 1) & 3,
+            "ebreak": (flags >> 3) & 1,
+            "knob": round(knob / 32767, 4),
+            "duty": round(duty / 32767, 4),
+            "speed": "" if speed == -32768 else round(speed / 32767, 4),
+            "battery_v": battery / 1000,
+            "progress": "" if progress == 255 else progress / 200,
+        }
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("input", help="serial port or raw capture file")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("-o", "--output", help="CSV file (default stdout)")
+    ap.add_argument("--start", action="store_true", help="send 'b' to start the stream")
+    args = ap.parse_args()
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=FIELDS)
+    writer.writeheader()
+    dec = Decoder()
+
+    try:
+        if os.path.isfile(args.input):
+            with open(args.input, "rb") as f:
+                for row in dec.feed(f.read()):
+                    writer.writerow(row)
+        else:
+            import serial
+            with serial.Serial(args.input, args.baud, timeout=0.1) as port:
+                if args.start:
+                    port.write(b"b")
+                while True:
+                    for row in dec.feed(port.read(4096)):
+                        writer.writerow(row)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out is not sys.stdout:
+            out.close()
+        print("%d frames, %d lost, %d bad" % (dec.frames, dec.lost, dec.bad), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
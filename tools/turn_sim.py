@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""Check the back-EMF turn counter (SpeedControl::turnsSince()) on a DC-motor model.
+
+The motor is the lumped model of decay_sim.py behind a GEAR:1 gearbox, driven by
+the software PWM in fast decay with the driver's back-EMF windows: every
+IRF_BEMF_INTERVAL_US one period ends in a coast of at least IRF_BEMF_WINDOW_US.
+At each window the AnalogSampler burst is replayed: a blanking conversion, then
+terminal 1 and terminal 2 one ADC conversion (104 us) apart, 10-bit readings of
+the 40 V dividers. The lower terminal floats down until the low-side body diode
+clamps it and reads 0 (ANALOG_BEMF_CLAMP), and while the winding current is
+still decaying one terminal sits above the pack (setBackEmfRail() drops those).
+The difference goes into the same integer trapezoid integral as the ADC ISR
+(codes x 256 us, micros() in 4 us steps), and turns are counted with the
+firmware's SPEED_INTEGRAL_PER_TURN_Q8. An e-break shorts the winding and opens
+no windows; the integral restarts after it (IRF_PHASE_BRAKE) and after a gap
+over ANALOG_BEMF_MAX_GAP_US.
+
+The load torque on the spindle ramps up with the depth, like a tap going in.
+
+    turn_sim.py                            # TORQUE profile, 0.3/0.6/0.9 duty
+    turn_sim.py --turns 1 --full-rpm 450 0.8 -0.7
+    turn_sim.py --clamp 0.3 --no-rail 0.3  # board clamp differs, no rail check
+    turn_sim.py --hole --turns 1 -0.9      # back out, e-break, wait, next hole
+    turn_sim.py --hole --bridge-gaps -0.9  # the same with the old gap bridging
+
+--full-rpm defaults to the spindle speed at SPEED_BEMF_FULL_SCALE back-EMF for
+this model, the value SPEED_FULL_RPM has to be calibrated to. Columns: true and
+counted turns when the counter reached --turns (a tapTurns() step), the error,
+and the time the step took from standstill.
+
+--hole runs the end of one hole and the first step of the next: a half-turn
+step backwards at the given duty, the e-break of TapMode::sequenceComplete()
+for --brake-ms, then a forward step of --turns at the same magnitude, counted
+from a mark taken as the step starts. Its columns are for that forward step,
+and it exits with 1 if any is off by more than 10%.
+"""
+
+import argparse
+import math
+import random
+import sys
+
+V = 18.0        # Pack voltage
+R = 0.4         # Winding resistance, ohm
+L = 150e-6      # Winding inductance, H
+KE = 0.012      # Back-EMF constant, V s/rad (= Kt in N m/A)
+J = 2e-5        # Rotor inertia with the reflected gearbox, kg m^2
+B = 2e-6        # Viscous friction, N m s/rad
+TC = 0.02       # Coulomb friction, N m at the motor
+DIODE = 0.7     # One body diode carrying the winding current, V
+CLAMP = 0.5     # The same diode holding the floating terminal up against its divider, V
+GEAR = 45       # Motor turns per spindle turn
+
+LOAD_START = 0.5    # Tap load at the spindle, N m, at the first turn
+LOAD_PER_TURN = 1.5 # and rising per turn of depth
+
+# Firmware constants (IRFMotorDriver.h, AnalogSampler, SpeedControl.h)
+PWM_TICK_US = 64            # IRF_PWM_TORQUE: /1024
+PWM_STEPS = 255
+BEMF_INTERVAL_US = 16000
+BEMF_WINDOW_US = 352
+ADC_CONV_US = 104           # 13 ADC clocks at 16 MHz / 128
+ADC_SH_US = 12              # Sample and hold 1.5 ADC clocks into a conversion
+DIVIDER_V = 40.0            # 40 V full scale on the terminal inputs
+BEMF_FULL_SCALE = 1739      # SPEED_BEMF_FULL_SCALE, 12-bit codes
+BEMF_CLAMP = 51             # ANALOG_BEMF_CLAMP, 12-bit codes
+BEMF_MAX_GAP_US = 64000     # ANALOG_BEMF_MAX_GAP_US
+
+DT = 4e-6       # Integration step, s (micros() resolution)
+TIMEOUT = 5.0
+
+
+def full_rpm():
+    """Spindle rpm at BEMF_FULL_SCALE back-EMF, the calibrated SPEED_FULL_RPM."""
+    emf = BEMF_FULL_SCALE / 4092.0 * DIVIDER_V
+    return emf / KE * 60 / (2 * math.pi) / GEAR
+
+
+def adc10(v, noise):
+    code = int(v / DIVIDER_V * 1023 + noise.uniform(-1.0, 1.0))
+    return max(0, min(1023, code))
+
+
+def terminals(emf, i, clamp):
+    """Terminal 1 and 2 to ground while the bridge is off."""
+    if i != 0.0:
+        # Fast decay: the current flows back into the pack through two body diodes
+        hi, lo = V + DIODE, -DIODE
+        return (lo, hi) if i > 0 else (hi, lo)
+    # Floating: the dividers pull the lower terminal down to the body diode clamp
+    hi, lo = abs(emf) - clamp, -clamp
+    if abs(emf) < 2 * clamp:
+        hi, lo = abs(emf) / 2, -abs(emf) / 2
+    return (hi, lo) if emf >= 0 else (lo, hi)
+
+
+class Sim:
+    """Motor, driver and AnalogSampler state, carried from one step to the next."""
+
+    def __init__(self, args):
+        self.noise = random.Random(args.seed)
+        # Battery channel, same divider
+        self.rail = 0 if args.no_rail else int(V / DIVIDER_V * 1023) << 2
+        self.clamp = args.clamp
+        self.bridge_gaps = args.bridge_gaps
+        self.per_turn_q8 = (BEMF_FULL_SCALE * (60000000 // args.full_rpm)) >> 16
+        self.t_us = 0
+        self.i = self.w = self.angle = 0.0   # Signed, positive is forward
+        self.periods = 0
+        self.run_on = 0
+        self.samples = []   # (time, what) still to come in the running back-EMF burst
+        self.codes = [0, 0]
+        self.bemf_prev = 0
+        self.bemf_time = 0
+        self.restart = False
+        self.integral = 0
+
+    def turns(self):
+        return self.angle / (2 * math.pi) / GEAR
+
+    def counted_q8(self, mark):
+        # SpeedControl::turnsSince(): C division truncates towards zero
+        return int((self.integral - mark) / self.per_turn_q8)
+
+    def sample(self):
+        """AnalogSampler::backEmfSample() after terminal 2"""
+        if self.rail and max(self.codes) << 2 >= self.rail:
+            return  # Still decaying into the pack, dropped (setBackEmfRail())
+        bemf = (self.codes[0] - self.codes[1]) << 2
+        if bemf:
+            bemf += BEMF_CLAMP if bemf > 0 else -BEMF_CLAMP
+        now = self.t_us & ~3
+        gap = now - self.bemf_time
+        self.bemf_time = now
+        if self.bridge_gaps:
+            self.integral += ((self.bemf_prev + bemf) * min(gap >> 2, 65535)) >> 7
+        elif gap <= BEMF_MAX_GAP_US and not self.restart:
+            self.integral += ((self.bemf_prev + bemf) * (gap >> 2)) >> 7
+        self.restart = False
+        self.bemf_prev = bemf
+
+    def step(self, duty, done, brake=False):
+        """Drive at duty, or e-break, until done() is true. False on timeout."""
+        sign = 1 if duty >= 0 else -1
+        period = PWM_STEPS * PWM_TICK_US
+        on_ticks = min(PWM_STEPS, int(round(abs(duty) * PWM_STEPS)))
+        coast_ticks = -(-BEMF_WINDOW_US // PWM_TICK_US)
+        every = max(1, BEMF_INTERVAL_US // period)
+        step_us = int(DT * 1e6)
+        end = self.t_us + int(TIMEOUT * 1e6)
+        while self.t_us < end:
+            pos = self.t_us % period
+            if pos == 0 and brake:
+                self.restart = True     # IRF_PHASE_BRAKE, no window
+            elif pos == 0:
+                # Period start, as IRFMotorDriver::preparePeriod() laid it out
+                self.periods += 1
+                on = on_ticks
+                window = self.periods % every == 0
+                if window and on != 0 and PWM_STEPS - on < coast_ticks:
+                    on = PWM_STEPS - coast_ticks
+                self.run_on = on * PWM_TICK_US
+                if window:
+                    start = self.t_us + self.run_on
+                    self.samples = [(start + ADC_CONV_US + ADC_SH_US, 0),
+                                    (start + 2 * ADC_CONV_US + ADC_SH_US, 1),
+                                    (start + 3 * ADC_CONV_US, 2)]
+
+            emf = KE * self.w
+            i = self.i
+            if brake:
+                i += (-R * i - emf) / L * DT    # Winding shorted
+            elif pos < self.run_on:
+                i += (V * sign - R * i - emf) / L * DT
+            elif i * sign > 0:
+                i += (-(V + 2 * DIODE) * sign - R * i - emf) / L * DT
+                if i * sign < 0:
+                    i = 0.0
+            else:
+                i = 0.0
+            self.i = i
+
+            while self.samples and self.t_us >= self.samples[0][0]:
+                what = self.samples.pop(0)[1]
+                if what < 2:
+                    self.codes[what] = adc10(terminals(emf, i, self.clamp)[what], self.noise)
+                else:
+                    self.sample()
+
+            # Coulomb friction and the tap load oppose the motion, or hold a standing spindle
+            friction = TC + (LOAD_START + LOAD_PER_TURN * abs(self.turns())) / GEAR
+            torque = KE * i - B * self.w
+            if self.w != 0:
+                w = self.w + (torque - math.copysign(friction, self.w)) / J * DT
+                self.w = 0.0 if w * self.w < 0 else w
+            elif abs(torque) > friction:
+                self.w = (torque - math.copysign(friction, torque)) / J * DT
+            self.angle += self.w * DT
+            self.t_us += step_us
+            if done():
+                return True
+        return False
+
+
+def counted_step(sim, duty, turns):
+    """A tapTurns() step from a mark taken now: true and counted turns, time or None."""
+    sign = 1 if duty >= 0 else -1
+    target_q8 = int(turns * 256 + 0.5)
+    mark, start_turns, start_us = sim.integral, sim.turns(), sim.t_us
+    ok = sim.step(duty, lambda: sim.counted_q8(mark) * sign >= target_q8)
+    true = (sim.turns() - start_turns) * sign
+    counted = sim.counted_q8(mark) * sign / 256.0
+    return true, counted, (sim.t_us - start_us) / 1e6 if ok else None
+
+
+def hole(duty, args):
+    """Back out half a turn, e-break, stand, then the next hole's first forward step."""
+    sim = Sim(args)
+    counted_step(sim, -abs(duty), 0.5)
+    stop = sim.t_us + args.brake_ms * 1000
+    sim.step(0, lambda: sim.t_us >= stop, brake=True)
+    return counted_step(sim, abs(duty), args.turns)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("duty", type=float, nargs="*", default=[0.3, 0.6, 0.9])
+    ap.add_argument("--turns", type=float, default=2.0, help="tapTurns() of the step")
+    ap.add_argument("--full-rpm", type=int, default=int(round(full_rpm())),
+                    help="SPEED_FULL_RPM the firmware is built with")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--clamp", type=float, default=CLAMP,
+                    help="diode clamp of the floating terminal on the board, V")
+    ap.add_argument("--no-rail", action="store_true",
+                    help="keep the samples taken while the current still decays")
+    ap.add_argument("--hole", action="store_true",
+                    help="back out, e-break and count the next hole's first step")
+    ap.add_argument("--brake-ms", type=int, default=1000, help="standstill between the holes")
+    ap.add_argument("--bridge-gaps", action="store_true",
+                    help="integrate across e-breaks and long gaps, as before the restart")
+    args = ap.parse_args()
+
+    print("SPEED_FULL_RPM %d (model: %.0f)" % (args.full_rpm, full_rpm()))
+    print(" duty | true turns  counted  error | step ms")
+    failed = False
+    for d in args.duty:
+        if args.hole:
+            true, counted, t = hole(d, args)
+        else:
+            true, counted, t = counted_step(Sim(args), d, args.turns)
+        err = (counted - true) / true * 100 if true else float("nan")
+        print("%5.2f |   %8.3f %8.3f %5.1f%% | %s"
+              % (d, true, counted, err, "%7.0f" % (t * 1000) if t is not None else "timeout"))
+        failed |= args.hole and not abs(err) <= 10
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()